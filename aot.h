@@ -0,0 +1,18 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// the ROM translated to C ahead of time, aot_invaders.c is written by recompile at build time
+
+// CRC32 of the image it was generated from, the engine refuses any other ROM
+extern const uint32_t aotRomCrc;
+
+// same contract as Engine.run: at least one instruction, then on while used < budget
+// PCs outside the translated code (RAM, PCHL targets it couldn't see) go to nextOp8080
+int aotRun(State8080* state, Machine* machine, int budget);
+
+#endif
@@ -0,0 +1,268 @@
+// speed benchmarks, written out as JSON so runs can be compared over time
+//   micro: tight loops of one opcode class each, run through nextOp8080/emulateOp8080 on a bare 64 KB machine
+//   macro: whole frames of the real ROM on the chosen engine, attract mode plus any recorded movies
+//   multi: attract mode on many instances at once, a frame of each in turn on one thread, so their
+//          state and RAM compete for the cache the way a batch driver's would, out of an instance
+//          pool (-H for huge pages)
+//
+// usage: ./bench [-e engine] [-n instructions] [-f frames] [-i instances] [-H] [-m movie]... [-o out.json]
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "movie.h"
+#include "pool.h"
+#include "rom.h"
+#include "platform.h"
+
+#define LOOP_START 0x1000
+#define LOOP_REPEATS 256
+#define STUB 0x8000 // CALL target for the Ccc/Rcc loop
+#define DATA 0x9000 // HL points here for the M operand loops
+#define MAX_MOVIES 16
+
+typedef struct MicroBench {
+	const char* name;
+	u8 body[4]; // one copy of the loop body
+	int len;
+} MicroBench;
+
+// all the flags are clear when these start, so the NZ conditions are always taken
+static const MicroBench micros[] = {
+	{"mov_r_r",   {0x41}, 1},             // MOV B,C
+	{"mov_r_m",   {0x46}, 1},             // MOV B,M
+	{"mov_m_r",   {0x70}, 1},             // MOV M,B
+	{"alu_reg",   {0x80}, 1},             // ADD B
+	{"alu_m",     {0x86}, 1},             // ADD M
+	{"alu_imm",   {0xC6, 0x01}, 2},       // ADI 1
+	{"jcc",       {0xC2, 0x00, 0x00}, 3}, // JNZ next (target patched in)
+	{"ccc_rcc",   {0xC4, STUB & 0xFF, STUB >> 8}, 3}, // CNZ stub, stub is RNZ
+	{"push_pop",  {0xC5, 0xC1}, 2},       // PUSH B, POP B
+	{"dad",       {0x09}, 1},             // DAD B
+	{"daa",       {0x27}, 1},             // DAA
+};
+static const int numMicros = sizeof(micros) / sizeof(micros[0]);
+
+// hardware counters, where the kernel lets us have them
+typedef struct PerfCounters {
+	int fds[3];
+	uint64_t values[3];
+	bool ok[3];
+} PerfCounters;
+
+enum { PERF_CACHE_MISSES, PERF_INSTRUCTIONS, PERF_CYCLES };
+
+static int openCounter(uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void startCounters(PerfCounters* pc) {
+	uint64_t configs[3] = {PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES};
+	for (int i = 0; i < 3; i++) {
+		pc->fds[i] = openCounter(configs[i]);
+		pc->ok[i] = false;
+		if (pc->fds[i] < 0) continue;
+		ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+static void stopCounters(PerfCounters* pc) {
+	for (int i = 0; i < 3; i++) {
+		if (pc->fds[i] < 0) continue;
+		ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		pc->ok[i] = read(pc->fds[i], &pc->values[i], sizeof(uint64_t)) == sizeof(uint64_t);
+		close(pc->fds[i]);
+	}
+}
+
+// null when the counter isn't available
+static void printCounters(FILE* out, PerfCounters* pc) {
+	const char* names[3] = {"cache_misses", "host_instructions", "host_cycles"};
+	for (int i = 0; i < 3; i++) {
+		if (pc->ok[i]) fprintf(out, ", \"%s\": %llu", names[i], (unsigned long long)pc->values[i]);
+		else fprintf(out, ", \"%s\": null", names[i]);
+	}
+	if (pc->ok[PERF_INSTRUCTIONS] && pc->ok[PERF_CYCLES] && pc->values[PERF_CYCLES] > 0) {
+		fprintf(out, ", \"ipc\": %.3f", (double)pc->values[PERF_INSTRUCTIONS] / pc->values[PERF_CYCLES]);
+	}
+	else fprintf(out, ", \"ipc\": null");
+}
+
+static void setupMicro(State8080* state, const MicroBench* mb) {
+	u16 addr = LOOP_START;
+	for (int i = 0; i < LOOP_REPEATS; i++) {
+		memcpy(state->memory + addr, mb->body, mb->len);
+		// JNZ to the next copy
+		if (mb->body[0] == 0xC2) {
+			state->memory[addr+1] = (addr + 3) & 0xFF;
+			state->memory[addr+2] = (addr + 3) >> 8;
+		}
+		addr += mb->len;
+	}
+	// JMP LOOP_START
+	state->memory[addr] = 0xC3;
+	state->memory[addr+1] = LOOP_START & 0xFF;
+	state->memory[addr+2] = LOOP_START >> 8;
+	state->memory[STUB] = 0xC0; // RNZ
+	state->pc = LOOP_START;
+	state->sp = 0xF000;
+	state->regs[REG_H] = DATA >> 8;
+	state->regs[REG_L] = DATA & 0xFF;
+	state->psw = 2;
+}
+
+static void runMicro(FILE* out, const MicroBench* mb, int64_t instructions, bool last) {
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+	setupMicro(state, mb);
+	int64_t cycles = 0;
+	PerfCounters pc;
+	startCounters(&pc);
+	int64_t start = currNano();
+	for (int64_t i = 0; i < instructions; i++) cycles += nextOp8080(state, machine);
+	int64_t nanos = currNano() - start;
+	stopCounters(&pc);
+	fprintf(out, "    {\"name\": \"%s\", \"instructions\": %lld, \"cycles\": %lld, \"ns\": %lld, \"ns_per_instr\": %.3f, \"mips\": %.2f",
+			mb->name, (long long)instructions, (long long)cycles, (long long)nanos,
+			(double)nanos / instructions, instructions * 1e3 / nanos);
+	printCounters(out, &pc);
+	fprintf(out, "}%s\n", last ? "" : ",");
+	freeState8080(state);
+	free(machine);
+}
+
+// s as a JSON string, quotes included (movie names are paths, anything can be in them)
+static void printJsonString(FILE* out, const char* s) {
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+		else if (c < 0x20) fprintf(out, "\\u%04x", c);
+		else fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static void runMacro(FILE* out, const Engine* engine, const u8* rom, const char* name, Movie* movie, int frames, bool last) {
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+	machineMapMemory(machine, state, rom);
+	if (!attachEngine(engine, state)) exit(1);
+	int64_t clock = 0;
+	PerfCounters pc;
+	startCounters(&pc);
+	int64_t start = currNano();
+	for (int f = 0; f < frames; f++) {
+		if (movie != NULL) playFrame(movie, machine, f);
+		runFrame(engine, state, machine, &clock);
+	}
+	int64_t nanos = currNano() - start;
+	stopCounters(&pc);
+	fprintf(out, "    {\"name\": ");
+	printJsonString(out, name);
+	fprintf(out, ", \"frames\": %d, \"cycles\": %lld, \"ns\": %lld, \"ns_per_frame\": %.1f, \"fps\": %.1f, \"mcycles_per_s\": %.2f",
+			frames, (long long)clock, (long long)nanos, (double)nanos / frames,
+			frames * 1e9 / nanos, clock * 1e3 / nanos);
+	printCounters(out, &pc);
+	fprintf(out, "}%s\n", last ? "" : ",");
+	freeState8080(state);
+	free(machine);
+}
+
+static void runMulti(FILE* out, const Engine* engine, const u8* rom, int instances, int frames, int poolFlags) {
+	int64_t setup = currNano();
+	InstancePool* pool = initPool(instances, &boards[0], rom, engine, poolFlags);
+	if (pool == NULL) exit(1);
+	Instance** running = malloc(instances * sizeof(Instance*));
+	for (int i = 0; i < instances; i++) running[i] = acquireInstance(pool);
+	setup = currNano() - setup;
+	int64_t cycles = 0;
+	PerfCounters pc;
+	startCounters(&pc);
+	int64_t start = currNano();
+	for (int f = 0; f < frames; f++) {
+		for (int i = 0; i < instances; i++) runFrame(engine, running[i]->state, running[i]->machine, &running[i]->clock);
+	}
+	int64_t nanos = currNano() - start;
+	stopCounters(&pc);
+	for (int i = 0; i < instances; i++) cycles += running[i]->clock;
+	int64_t total = (int64_t)frames * instances;
+	fprintf(out, "    {\"name\": \"attract\", \"instances\": %d, \"bytes_per_instance\": %zu, \"huge_pages\": %s, \"setup_ns\": %lld, \"frames\": %lld, \"cycles\": %lld, \"ns\": %lld, \"ns_per_frame\": %.1f, \"fps\": %.1f, \"mcycles_per_s\": %.2f",
+			instances, poolBytesPerInstance(pool), pool->hugePages ? "true" : "false", (long long)setup,
+			(long long)total, (long long)cycles, (long long)nanos, (double)nanos / total,
+			total * 1e9 / nanos, cycles * 1e3 / nanos);
+	printCounters(out, &pc);
+	fprintf(out, "}\n");
+	free(running);
+	freePool(pool);
+}
+
+int main(int argc, char** argv) {
+	const char* engineName = "interp";
+	const char* outName = NULL;
+	const char* movieNames[MAX_MOVIES];
+	int numMovies = 0;
+	int64_t instructions = 20000000;
+	int frames = 3600;
+	int instances = 16;
+	int poolFlags = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-e") && i + 1 < argc) engineName = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) instructions = atoll(argv[++i]);
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i") && i + 1 < argc) instances = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-H")) poolFlags |= POOL_HUGEPAGES;
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc && numMovies < MAX_MOVIES) movieNames[numMovies++] = argv[++i];
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) outName = argv[++i];
+		else {
+			printf("usage: %s [-e engine] [-n instructions] [-f frames] [-i instances] [-H] [-m movie]... [-o out.json]\n", argv[0]);
+			return 1;
+		}
+	}
+	const Engine* engine = findEngine(engineName);
+	if (engine == NULL) return 1;
+	const u8* rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	Movie* movies[MAX_MOVIES];
+	for (int i = 0; i < numMovies; i++) {
+		movies[i] = loadMovie(movieNames[i]);
+		if (movies[i] == NULL) return 1;
+	}
+	FILE* out = stdout;
+	if (outName != NULL && (out = fopen(outName, "w")) == NULL) {
+		printf("Could not write %s\n", outName);
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"engine\": \"%s\",\n  \"timestamp\": %lld,\n", engine->name, (long long)time(NULL));
+	fprintf(out, "  \"micro\": [\n");
+	for (int i = 0; i < numMicros; i++) runMicro(out, &micros[i], instructions, i == numMicros - 1);
+	fprintf(out, "  ],\n  \"macro\": [\n");
+	runMacro(out, engine, rom, "attract", NULL, frames, numMovies == 0);
+	for (int i = 0; i < numMovies; i++) {
+		runMacro(out, engine, rom, movieNames[i], movies[i], movies[i]->frames, i == numMovies - 1);
+	}
+	fprintf(out, "  ],\n  \"multi\": [\n");
+	runMulti(out, engine, rom, instances, frames, poolFlags);
+	fprintf(out, "  ]\n}\n");
+	if (out != stdout) fclose(out);
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "board.h"
+
+// the control panel is wired the same on all of these, player 1 and coins on port 1, player 2 on port 2
+#define TAITO_KEYS { \
+	[MK_COIN] = {1, 0x01}, [MK_2P_START] = {1, 0x02}, [MK_1P_START] = {1, 0x04}, \
+	[MK_1P_SHOT] = {1, 0x10}, [MK_1P_LEFT] = {1, 0x20}, [MK_1P_RIGHT] = {1, 0x40}, \
+	[MK_2P_SHOT] = {2, 0x10}, [MK_2P_LEFT] = {2, 0x20}, [MK_2P_RIGHT] = {2, 0x40} \
+}
+
+// the later boards add a ROM at 0x4000 and colour RAM at 0xC000, so the address decoder
+// can't just ignore A14/A15 like the original does
+const Board boards[] = {
+	{
+		.name = "invaders",
+		.title = "Space Invaders",
+		.roms = {
+			{"invaders.h", 0x0000, 0x800, 0x734f5ad8},
+			{"invaders.g", 0x0800, 0x800, 0x6bfaca4a},
+			{"invaders.f", 0x1000, 0x800, 0x0ccead96},
+			{"invaders.e", 0x1800, 0x800, 0x14e538b0},
+		},
+		.romSize = 0x2000,
+		.regions = {
+			{REGION_ROM, 0x0000, 0x2000},
+			{REGION_RAM, 0x2000, 0x4000},
+			{REGION_MIRROR, 0x4000, 0x8000, 0x0000},
+			{REGION_MIRROR, 0x8000, 0xC000, 0x0000},
+			{REGION_MIRROR, 0xC000, 0x10000, 0x0000},
+		},
+		.halfVector = 0xCF, .fullVector = 0xD7,
+		.shiftCountPort = 2, .shiftDataPort = 4, .shiftReadPort = 3,
+		.keys = TAITO_KEYS,
+		.videoStart = 0x2400, .videoEnd = 0x4000,
+	},
+	{
+		.name = "invadpt2",
+		.title = "Space Invaders Part II",
+		.roms = {
+			{"pv01", 0x0000, 0x800},
+			{"pv02", 0x0800, 0x800},
+			{"pv03", 0x1000, 0x800},
+			{"pv04", 0x1800, 0x800},
+			{"pv05", 0x4000, 0x800},
+		},
+		.romSize = 0x4800,
+		.regions = {
+			{REGION_ROM, 0x0000, 0x2000},
+			{REGION_RAM, 0x2000, 0x4000},
+			{REGION_ROM, 0x4000, 0x4800},
+			{REGION_RAM, 0xC000, 0xE000},
+		},
+		.halfVector = 0xCF, .fullVector = 0xD7,
+		.shiftCountPort = 2, .shiftDataPort = 4, .shiftReadPort = 3,
+		.keys = TAITO_KEYS,
+		.videoStart = 0x2400, .videoEnd = 0x4000,
+		.colorStart = 0xC400,
+	},
+	{
+		.name = "lrescue",
+		.title = "Lunar Rescue",
+		.roms = {
+			{"lrescue.1", 0x0000, 0x800},
+			{"lrescue.2", 0x0800, 0x800},
+			{"lrescue.3", 0x1000, 0x800},
+			{"lrescue.4", 0x1800, 0x800},
+			{"lrescue.5", 0x4000, 0x800},
+			{"lrescue.6", 0x4800, 0x800},
+		},
+		.romSize = 0x5000,
+		.regions = {
+			{REGION_ROM, 0x0000, 0x2000},
+			{REGION_RAM, 0x2000, 0x4000},
+			{REGION_ROM, 0x4000, 0x5000},
+			{REGION_RAM, 0xC000, 0xE000},
+		},
+		.halfVector = 0xCF, .fullVector = 0xD7,
+		.shiftCountPort = 2, .shiftDataPort = 4, .shiftReadPort = 3,
+		.keys = TAITO_KEYS,
+		.videoStart = 0x2400, .videoEnd = 0x4000,
+		.colorStart = 0xC400,
+	},
+	{
+		.name = "ballbomb",
+		.title = "Balloon Bomber",
+		.roms = {
+			{"tn01", 0x0000, 0x800},
+			{"tn02", 0x0800, 0x800},
+			{"tn03", 0x1000, 0x800},
+			{"tn04", 0x1800, 0x800},
+			{"tn05-1", 0x4000, 0x800},
+		},
+		.romSize = 0x4800,
+		.regions = {
+			{REGION_ROM, 0x0000, 0x2000},
+			{REGION_RAM, 0x2000, 0x4000},
+			{REGION_ROM, 0x4000, 0x4800},
+			{REGION_RAM, 0xC000, 0xE000},
+		},
+		.halfVector = 0xCF, .fullVector = 0xD7,
+		.shiftCountPort = 2, .shiftDataPort = 4, .shiftReadPort = 3,
+		.keys = TAITO_KEYS,
+		.videoStart = 0x2400, .videoEnd = 0x4000,
+		.colorStart = 0xC400,
+	},
+};
+const int numBoards = sizeof(boards) / sizeof(boards[0]);
+
+const Board* findBoard(const char* name) {
+	for (int i = 0; i < numBoards; i++) {
+		if (!strcmp(boards[i].name, name)) return &boards[i];
+	}
+	printf("No board called %s, have:", name);
+	for (int i = 0; i < numBoards; i++) printf(" %s", boards[i].name);
+	printf("\n");
+	return NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+enum MKey {
+	MK_COIN, MK_2P_START, MK_1P_START, MK_1P_SHOT, MK_1P_LEFT, MK_1P_RIGHT, MK_2P_SHOT, MK_2P_LEFT, MK_2P_RIGHT,
+	MK_KEYS
+};
+
+#define BOARD_MAX_ROMS 8
+#define BOARD_MAX_REGIONS 8
+
+// one 2 KB (or whatever size) chip and where it sits in the address space
+typedef struct RomPart {
+	const char* name; // file name, same as the MAME romset
+	u16 addr;
+	u16 size;
+	uint32_t crc; // 0 if we don't know it, then the part is loaded unchecked
+} RomPart;
+
+enum RegionKind {
+	REGION_ROM, // the ROM image at the same addresses
+	REGION_RAM,
+	REGION_MIRROR // an alias of the same sized range at src
+};
+
+typedef struct MemRegion {
+	enum RegionKind kind;
+	int start, end; // page aligned
+	int src;
+} MemRegion;
+
+typedef struct InputBit {
+	u8 port;
+	u8 mask;
+} InputBit;
+
+// everything that differs between the Taito/Midway 8080 boards the core can run
+// the ports are data rather than code, readPort and writePort stay direct calls with no
+// per-board branching beyond comparing a port number
+typedef struct Board {
+	const char* name; // the MAME set name, -b picks a board by it
+	const char* title;
+	RomPart roms[BOARD_MAX_ROMS]; // a NULL name ends the list
+	int romSize; // the loaded image covers [0, romSize) of the address space
+	MemRegion regions[BOARD_MAX_REGIONS]; // applied in order, anything not covered is plain RAM
+	u8 halfVector; // RST opcodes for the mid-screen and vblank interrupts
+	u8 fullVector;
+	// the MB14241 barrel shifter
+	u8 shiftCountPort;
+	u8 shiftDataPort;
+	u8 shiftReadPort;
+	u8 ports[4]; // what the read ports hold at power on (DIP switches and always-high bits)
+	InputBit keys[MK_KEYS];
+	// 1bpp, a column of the unrotated screen per 32 bytes
+	u16 videoStart;
+	u16 videoEnd;
+	u16 colorStart; // colour RAM, 0 if the board is black and white
+} Board;
+
+// the first entry is Space Invaders, what everything uses unless told otherwise
+extern const Board boards[];
+extern const int numBoards;
+
+// NULL (after listing what there is) if there's no board called name
+const Board* findBoard(const char* name);
+
+#endif
@@ -1,2 +1,19 @@
 #!/bin/bash
-gcc disassemble.c emulate8080.c machine.c platform.c `sdl2-config --cflags --libs`
+CORE="disassemble.c emulate8080.c machine.c board.c rom.c clock.c"
+gcc $CORE platform.c debugger.c movie.c capture.c telemetry.c input.c coverage.c publish.c `sdl2-config --cflags --libs`
+gcc -O2 -o cputest cputest.c $CORE -lpthread
+# the aot engine is the ROM translated to C, regenerated on every build
+gcc -O2 -o recompile recompile.c cfg.c $CORE -lpthread
+./recompile -o aot_invaders.c roms
+# fused.h (the sequences the fused engine runs as one) is regenerated with ./fusegen -m movie
+gcc -O2 -o fusegen fusegen.c cfg.c movie.c $CORE -lpthread
+ENGINES="engine.c aot_invaders.c fuse.c cfg.c"
+gcc -O2 -o lockstep lockstep.c $ENGINES movie.c $CORE -lpthread
+gcc -O2 -o bench bench.c pool.c snapshot.c $ENGINES movie.c $CORE -lpthread
+gcc -O2 -o headless headless.c capture.c telemetry.c gamestate.c coverage.c publish.c ramstream.c $ENGINES movie.c $CORE -lpthread
+gcc -O2 -o framecheck framecheck.c capture.c hash.c $ENGINES movie.c $CORE -lpthread
+gcc -O2 -o covmerge covmerge.c coverage.c cfg.c $CORE -lpthread
+gcc -O2 -o fuzz fuzz.c snapshot.c gamestate.c coverage.c $ENGINES movie.c $CORE -lpthread
+gcc -O2 -o shmwatch shmwatch.c publish.c capture.c hash.c $CORE -lpthread
+gcc -O2 -o ramdump ramdump.c ramstream.c -lpthread
+gcc -O2 -o search search.c pool.c snapshot.c gamestate.c transtable.c $ENGINES movie.c $CORE -lpthread
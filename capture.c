@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+#include "capture.h"
+#include "machine.h"
+
+enum CaptureFormat captureFormatFor(const char* path) {
+	const char* dot = strrchr(path, '.');
+	if (strchr(path, '%') != NULL || (dot != NULL && !strcmp(dot, ".ppm"))) return CAPTURE_PPM;
+	if (dot != NULL && !strcmp(dot, ".y4m")) return CAPTURE_Y4M;
+	return CAPTURE_RAW;
+}
+
+// the screen as it's shown (rotated 90 degrees counterclockwise), 0 or 255 per pixel
+static void renderFrame(u8* image, const u8* vram, int scale) {
+	int width = SCREEN_WIDTH * scale;
+	for (int x = 0; x < SCREEN_WIDTH; x++) {
+		const u8* column = vram + x * (SCREEN_HEIGHT / 8);
+		for (int j = 0; j < SCREEN_HEIGHT; j++) {
+			u8 pixel = (column[j/8] >> (j%8) & 1) ? 255 : 0;
+			int y = SCREEN_HEIGHT - 1 - j;
+			for (int k = 0; k < scale; k++) {
+				memset(image + (y * scale + k) * width + x * scale, pixel, scale);
+			}
+		}
+	}
+}
+
+static void writePpm(FILE* f, const u8* image, int scale) {
+	int width = SCREEN_WIDTH * scale, height = SCREEN_HEIGHT * scale;
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	for (int i = 0; i < width * height; i++) {
+		u8 rgb[3] = {image[i], image[i], image[i]};
+		fwrite(rgb, 1, 3, f);
+	}
+}
+
+static void writeFrame(Capture* cap, CaptureFrame* frame) {
+	if (cap->format == CAPTURE_RAW) {
+		u8 index[4] = {frame->frame, frame->frame >> 8, frame->frame >> 16, frame->frame >> 24};
+		fwrite(index, 1, 4, cap->out);
+		fwrite(frame->vram, 1, VRAM_SZ, cap->out);
+		return;
+	}
+	renderFrame(cap->image, frame->vram, cap->scale);
+	if (cap->format == CAPTURE_Y4M) {
+		fprintf(cap->out, "FRAME\n");
+		fwrite(cap->image, 1, SCREEN_WIDTH * SCREEN_HEIGHT * cap->scale * cap->scale, cap->out);
+	}
+	else if (cap->out != NULL) writePpm(cap->out, cap->image, cap->scale);
+	else {
+		char name[1024];
+		snprintf(name, sizeof(name), "%.*s%u%s", cap->split, cap->path, frame->frame, cap->path + cap->split + 2);
+		FILE* f = fopen(name, "wb");
+		if (f == NULL) {
+			printf("Could not write %s\n", name);
+			return;
+		}
+		writePpm(f, cap->image, cap->scale);
+		fclose(f);
+	}
+}
+
+bool saveVramPpm(const char* path, const u8* vram, int scale) {
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		printf("Could not write %s\n", path);
+		return false;
+	}
+	u8* image = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * scale * scale);
+	renderFrame(image, vram, scale);
+	writePpm(f, image, scale);
+	free(image);
+	fclose(f);
+	return true;
+}
+
+static void* writerThread(void* arg) {
+	Capture* cap = arg;
+	struct timespec nap = {0, 1000000};
+	while (true) {
+		uint32_t tail = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+		if (tail == atomic_load_explicit(&cap->head, memory_order_acquire)) {
+			// only finish once done is seen with the ring empty, a last frame may land in between
+			if (atomic_load(&cap->done) && tail == atomic_load_explicit(&cap->head, memory_order_acquire)) break;
+			nanosleep(&nap, NULL);
+			continue;
+		}
+		writeFrame(cap, &cap->ring[tail % CAPTURE_SLOTS]);
+		cap->written++;
+		atomic_store_explicit(&cap->tail, tail + 1, memory_order_release);
+	}
+	return NULL;
+}
+
+Capture* initCapture(const char* path, enum CaptureFormat format, int scale, bool wait) {
+	Capture* cap = malloc(sizeof(Capture));
+	cap->path = path;
+	cap->format = format;
+	cap->scale = scale < 1 ? 1 : scale;
+	cap->wait = wait;
+	atomic_init(&cap->head, 0);
+	atomic_init(&cap->tail, 0);
+	atomic_init(&cap->done, false);
+	cap->dropped = 0;
+	cap->written = 0;
+	cap->image = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * cap->scale * cap->scale);
+	cap->out = NULL;
+	const char* percent = strchr(path, '%');
+	if (format == CAPTURE_PPM && percent != NULL) {
+		// the path is never a format string, only its one %d gets the frame number
+		if (percent[1] != 'd' || strchr(percent + 1, '%') != NULL) {
+			printf("A capture path can only have one %%d in it: %s\n", path);
+			free(cap->image);
+			free(cap);
+			return NULL;
+		}
+		cap->split = percent - path;
+	}
+	else {
+		cap->out = fopen(path, "wb");
+		if (cap->out == NULL) {
+			printf("Could not write %s\n", path);
+			free(cap->image);
+			free(cap);
+			return NULL;
+		}
+	}
+	if (format == CAPTURE_Y4M) {
+		fprintf(cap->out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", SCREEN_WIDTH * cap->scale, SCREEN_HEIGHT * cap->scale, FRAME_RATE);
+	}
+	pthread_create(&cap->thread, NULL, writerThread, cap);
+	return cap;
+}
+
+bool captureFrame(Capture* cap, const u8* vram, uint32_t frame) {
+	uint32_t head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+	while (head - atomic_load_explicit(&cap->tail, memory_order_acquire) == CAPTURE_SLOTS) {
+		if (!cap->wait) {
+			cap->dropped++;
+			return false;
+		}
+		sched_yield();
+	}
+	CaptureFrame* slot = &cap->ring[head % CAPTURE_SLOTS];
+	slot->frame = frame;
+	memcpy(slot->vram, vram, VRAM_SZ);
+	atomic_store_explicit(&cap->head, head + 1, memory_order_release);
+	return true;
+}
+
+void freeCapture(Capture* cap) {
+	atomic_store(&cap->done, true);
+	pthread_join(cap->thread, NULL);
+	if (cap->out != NULL) fclose(cap->out);
+	printf("captured %u frames to %s", cap->written, cap->path);
+	if (cap->dropped > 0) printf(" (dropped %u)", cap->dropped);
+	printf("\n");
+	free(cap->image);
+	free(cap);
+}
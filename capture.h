@@ -0,0 +1,67 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "machine.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+// video RAM is [0x2400, 0x4000), one bit per pixel, a column of the (unrotated) screen per 32 bytes
+#define VRAM_START 0x2400
+#define VRAM_SZ (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
+
+// frames in flight between the emulator and the writer thread
+#define CAPTURE_SLOTS 64
+
+enum CaptureFormat {
+	CAPTURE_RAW, // per frame: the frame number (4 bytes, little-endian) then the 7168 bytes of VRAM as is
+	CAPTURE_PPM, // binary PPMs, concatenated in one file or one file per frame if the path has a %d in it
+	CAPTURE_Y4M // greyscale YUV4MPEG2 at 60 fps
+};
+
+typedef struct CaptureFrame {
+	uint32_t frame;
+	u8 vram[VRAM_SZ];
+} CaptureFrame;
+
+// a single producer single consumer ring, the emulator pushes VRAM snapshots at vblank and
+// a background thread turns them into the chosen format
+typedef struct Capture {
+	const char* path;
+	FILE* out; // NULL for a PPM per frame
+	int split; // where path's %d is, for a PPM per frame
+	enum CaptureFormat format;
+	int scale;
+	bool wait; // block when the ring is full instead of dropping the frame
+	CaptureFrame ring[CAPTURE_SLOTS];
+	_Atomic uint32_t head; // next slot to fill, only the emulator writes it
+	_Atomic uint32_t tail; // next slot to write out, only the writer thread moves it
+	atomic_bool done;
+	uint32_t dropped;
+	uint32_t written;
+	u8* image; // the writer's scratch frame, rotated and scaled, one byte per pixel
+	pthread_t thread;
+} Capture;
+
+// .ppm and .y4m (or a %d in the path) pick those formats, anything else is raw
+enum CaptureFormat captureFormatFor(const char* path);
+
+// starts the writer thread, NULL (after printing why) if path can't be opened
+// wait is for headless runs where every frame matters more than keeping up with real time
+Capture* initCapture(const char* path, enum CaptureFormat format, int scale, bool wait);
+// call from the emulator thread once per frame (after the vblank interrupt)
+// copies the VRAM into the ring without taking a lock, false if it had to drop it
+bool captureFrame(Capture* cap, const u8* vram, uint32_t frame);
+// writes out everything still queued, stops the thread and closes the file
+void freeCapture(Capture* cap);
+
+// one frame straight to a PPM, on the calling thread
+bool saveVramPpm(const char* path, const u8* vram, int scale);
+
+#endif
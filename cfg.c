@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "emulate8080.h"
+
+Cfg* initCfg(const u8* code, int size) {
+	Cfg* cfg = malloc(sizeof(Cfg));
+	cfg->code = code;
+	cfg->size = size;
+	cfg->flags = calloc(size, 1);
+	cfg->instructions = 0;
+	cfg->blocks = 0;
+	cfg->indirect = 0;
+	return cfg;
+}
+
+void freeCfg(Cfg* cfg) {
+	free(cfg->flags);
+	free(cfg);
+}
+
+enum FlowKind flowKind8080(u8 op) {
+	switch (op) {
+		case 0xC3: case 0xCB: return FLOW_JUMP;
+		case 0xCD: case 0xDD: case 0xED: case 0xFD: return FLOW_CALL;
+		case 0xC9: case 0xD9: return FLOW_RET;
+		case 0xE9: return FLOW_INDIRECT;
+		case 0x76: return FLOW_HALT;
+	}
+	switch (op & 0xC7) {
+		case 0xC0: return FLOW_RET_CC;
+		case 0xC2: return FLOW_BRANCH;
+		case 0xC4: return FLOW_CALL;
+		case 0xC7: return FLOW_CALL; // RST
+	}
+	return FLOW_NEXT;
+}
+
+u16 flowTarget8080(const u8* code, u16 pc) {
+	u8 op = code[pc];
+	if ((op & 0xC7) == 0xC7) return op & 0x38;
+	return code[pc+1] | (u16)code[pc+2] << 8;
+}
+
+static void markLeader(Cfg* cfg, u16 addr) {
+	if (addr >= cfg->size || (cfg->flags[addr] & CFG_LEADER)) return;
+	cfg->flags[addr] |= CFG_LEADER;
+	cfg->blocks++;
+}
+
+void addCfgEntry(Cfg* cfg, u16 addr) {
+	if (addr >= cfg->size) return;
+	cfg->flags[addr] |= CFG_ENTRY;
+	markLeader(cfg, addr);
+	// every path is at most one address per byte, so the stack can't outgrow the image
+	u16* stack = malloc(cfg->size * sizeof(u16));
+	int top = 0;
+	stack[top++] = addr;
+	while (top > 0) {
+		u16 pc = stack[--top];
+		// straight line code until something that can't fall through or we join known code
+		while (pc < cfg->size && !(cfg->flags[pc] & CFG_CODE)) {
+			u8 op = cfg->code[pc];
+			int sz = opSize8080(op);
+			if (pc + sz > cfg->size) break; // runs off the end of the image
+			cfg->flags[pc] |= CFG_CODE;
+			cfg->instructions++;
+			enum FlowKind kind = flowKind8080(op);
+			u16 next = pc + sz;
+			if (kind == FLOW_JUMP || kind == FLOW_BRANCH || kind == FLOW_CALL) {
+				u16 target = flowTarget8080(cfg->code, pc);
+				markLeader(cfg, target);
+				if (target < cfg->size && !(cfg->flags[target] & CFG_CODE) && top < cfg->size) stack[top++] = target;
+			}
+			if (kind == FLOW_INDIRECT) cfg->indirect++;
+			if (kind == FLOW_JUMP || kind == FLOW_RET || kind == FLOW_INDIRECT) break;
+			if (kind != FLOW_NEXT) markLeader(cfg, next);
+			pc = next;
+		}
+	}
+	free(stack);
+}
@@ -0,0 +1,51 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+// control flow recovery over a ROM image: which bytes start instructions and which of
+// those start basic blocks, found by following every path from the entry points
+// (static only, PCHL targets aren't known until run time)
+
+enum CfgFlag {
+	CFG_CODE=1, // an instruction starts here
+	CFG_LEADER=2, // a basic block starts here
+	CFG_ENTRY=4 // one of the entry points (reset and the interrupt vectors)
+};
+
+// how an instruction leaves, as far as the interpreter is concerned
+enum FlowKind {
+	FLOW_NEXT, // falls through
+	FLOW_JUMP, // JMP
+	FLOW_BRANCH, // Jcc, target or fall through
+	FLOW_CALL, // CALL, Ccc and RST, target then (after the return) fall through
+	FLOW_RET, // RET
+	FLOW_RET_CC, // Rcc, return or fall through
+	FLOW_INDIRECT, // PCHL
+	FLOW_HALT // HLT, carries on after the interrupt
+};
+
+typedef struct Cfg {
+	const u8* code;
+	int size; // bytes from address 0
+	u8* flags; // one CfgFlag set per byte
+	int instructions;
+	int blocks;
+	int indirect; // PCHLs found
+} Cfg;
+
+Cfg* initCfg(const u8* code, int size);
+void freeCfg(Cfg* cfg);
+
+// marks addr as an entry point and follows everything reachable from it
+void addCfgEntry(Cfg* cfg, u16 addr);
+
+enum FlowKind flowKind8080(u8 op);
+// direct target of a JMP, Jcc, CALL, Ccc or RST at pc
+u16 flowTarget8080(const u8* code, u16 pc);
+
+#endif
@@ -0,0 +1,18 @@
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "platform.h"
+
+// kept out of platform.c so the headless tools don't need SDL
+int64_t currMicro() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+int64_t currNano() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coverage.h"
+
+static const char MAGIC[8] = "8080COV1";
+
+Coverage* initCoverage() {
+	return calloc(1, sizeof(Coverage));
+}
+
+void attachCoverage(State8080* state, Coverage* cov, bool branches) {
+	state->executed = cov->executed;
+	state->branches = branches ? cov->branches : NULL;
+}
+
+void detachCoverage(State8080* state) {
+	state->executed = NULL;
+	state->branches = NULL;
+}
+
+bool saveCoverage(const Coverage* cov, const char* filename) {
+	FILE* f = fopen(filename, "wb");
+	if (f == NULL) {
+		printf("Could not write %s\n", filename);
+		return false;
+	}
+	fwrite(MAGIC, 1, sizeof(MAGIC), f);
+	fwrite(cov->executed, 1, COVERAGE_EXECUTED_SZ, f);
+	fwrite(cov->branches, 1, COVERAGE_BRANCHES_SZ, f);
+	fclose(f);
+	return true;
+}
+
+Coverage* loadCoverage(const char* filename) {
+	FILE* f = fopen(filename, "rb");
+	if (f == NULL) {
+		printf("Error loading file: %s\n", filename);
+		return NULL;
+	}
+	char magic[sizeof(MAGIC)];
+	Coverage* cov = initCoverage();
+	bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, MAGIC, sizeof(MAGIC))
+		&& fread(cov->executed, 1, COVERAGE_EXECUTED_SZ, f) == COVERAGE_EXECUTED_SZ
+		&& fread(cov->branches, 1, COVERAGE_BRANCHES_SZ, f) == COVERAGE_BRANCHES_SZ;
+	fclose(f);
+	if (!ok) {
+		printf("%s is not a coverage file\n", filename);
+		free(cov);
+		return NULL;
+	}
+	return cov;
+}
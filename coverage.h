@@ -0,0 +1,38 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "emulate8080.h"
+
+// which instructions a session executed and which way its conditionals went
+// one bit per address for executed PCs, two for branches (bit 2*pc taken, 2*pc+1 not taken)
+// collected by nextOp8080, so only under the interpreter (the interp and idle engines)
+#define COVERAGE_EXECUTED_SZ (MEM_SZ / 8)
+#define COVERAGE_BRANCHES_SZ (MEM_SZ / 4)
+
+typedef struct Coverage {
+	u8 executed[COVERAGE_EXECUTED_SZ];
+	u8 branches[COVERAGE_BRANCHES_SZ];
+} Coverage;
+
+Coverage* initCoverage();
+// starts filling cov in from state's next instruction, branches too if asked
+void attachCoverage(State8080* state, Coverage* cov, bool branches);
+void detachCoverage(State8080* state);
+
+static inline bool coveredPc(const Coverage* cov, u16 pc) {
+	return cov->executed[pc >> 3] >> (pc & 7) & 1;
+}
+// 1 taken, 2 not taken, 3 both
+static inline int coveredBranch(const Coverage* cov, u16 pc) {
+	return cov->branches[pc >> 2] >> ((pc & 3) * 2) & 3;
+}
+
+// a small header and the two bitmaps
+bool saveCoverage(const Coverage* cov, const char* filename);
+// NULL (after printing why) if it can't be read or isn't a coverage file
+Coverage* loadCoverage(const char* filename);
+
+#endif
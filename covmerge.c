@@ -0,0 +1,128 @@
+// merges coverage files from any number of sessions (headless or platform -x/-X) and shows
+// which parts of the ROM none of them ever ran
+// each instruction in the static disassembly gets the number of sessions that executed it and,
+// for conditionals, how many took and didn't take it, ##### marks code nothing reached
+//
+// usage: ./covmerge [-o merged.cov] [-l listing.txt] file...
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulate8080.h"
+#include "coverage.h"
+#include "disassemble.h"
+#include "cfg.h"
+#include "rom.h"
+
+static uint32_t pcCounts[MEM_SZ];
+static uint32_t takenCounts[MEM_SZ];
+static uint32_t notTakenCounts[MEM_SZ];
+
+static bool isConditional(u8 op) {
+	return (op & 0xC7) == 0xC0 || (op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4;
+}
+
+static void writeListing(FILE* out, const u8* rom, Cfg* cfg, int sessions) {
+	fprintf(out, "# %d sessions, count of sessions that ran each instruction, T/N sessions that took / didn't take a conditional\n", sessions);
+	int gap = -1;
+	int pc = 0;
+	while (pc < ROM_SZ) {
+		if (!(cfg->flags[pc] & CFG_CODE)) {
+			if (gap < 0) gap = pc;
+			pc++;
+			continue;
+		}
+		if (gap >= 0) {
+			fprintf(out, "%18s%04X..%04X\n", "", gap, pc - 1);
+			gap = -1;
+		}
+		char buffer[64];
+		u8 op = rom[pc];
+		disassemble8080(buffer, op, pc + 1 < ROM_SZ ? rom[pc+1] : 0, pc + 2 < ROM_SZ ? rom[pc+2] : 0, pc);
+		char branch[16] = "";
+		if (isConditional(op)) snprintf(branch, sizeof(branch), "T%u N%u", takenCounts[pc], notTakenCounts[pc]);
+		if (pcCounts[pc] > 0) fprintf(out, "%6u %-11s%04X\t%s\n", pcCounts[pc], branch, pc, buffer);
+		else fprintf(out, "%6s %-11s%04X\t%s\n", "#####", branch, pc, buffer);
+		pc += opSize8080(op);
+	}
+	if (gap >= 0) fprintf(out, "%18s%04X..%04X\n", "", gap, ROM_SZ - 1);
+}
+
+int main(int argc, char** argv) {
+	const char* outName = NULL;
+	const char* listingName = NULL;
+	int first = 1;
+	for (; first < argc && argv[first][0] == '-'; first++) {
+		if (!strcmp(argv[first], "-o") && first + 1 < argc) outName = argv[++first];
+		else if (!strcmp(argv[first], "-l") && first + 1 < argc) listingName = argv[++first];
+		else break;
+	}
+	if (first == argc || argv[first][0] == '-') {
+		printf("usage: %s [-o merged.cov] [-l listing.txt] file...\n", argv[0]);
+		return 1;
+	}
+
+	Coverage* merged = initCoverage();
+	int sessions = 0;
+	for (int i = first; i < argc; i++) {
+		Coverage* cov = loadCoverage(argv[i]);
+		if (cov == NULL) return 1;
+		for (int pc = 0; pc < MEM_SZ; pc++) {
+			pcCounts[pc] += coveredPc(cov, pc);
+			int branch = coveredBranch(cov, pc);
+			takenCounts[pc] += branch & 1;
+			notTakenCounts[pc] += branch >> 1;
+		}
+		for (int j = 0; j < COVERAGE_EXECUTED_SZ; j++) merged->executed[j] |= cov->executed[j];
+		for (int j = 0; j < COVERAGE_BRANCHES_SZ; j++) merged->branches[j] |= cov->branches[j];
+		free(cov);
+		sessions++;
+	}
+	if (outName != NULL && !saveCoverage(merged, outName)) return 1;
+
+	// the static listing is everything reachable from the vectors, plus anything that ran
+	// (PCHL targets) and whatever that reaches
+	const u8* rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	Cfg* cfg = initCfg(rom, ROM_SZ);
+	addCfgEntry(cfg, 0x0000);
+	addCfgEntry(cfg, 0x0008);
+	addCfgEntry(cfg, 0x0010);
+	for (int pc = 0; pc < ROM_SZ; pc++) {
+		if (pcCounts[pc] > 0) addCfgEntry(cfg, pc);
+	}
+
+	int instructions = 0, covered = 0, conditionals = 0, both = 0, neverTaken = 0, neverNot = 0, ram = 0;
+	for (int pc = 0; pc < MEM_SZ; pc++) {
+		if (pc >= ROM_SZ) {
+			ram += pcCounts[pc] > 0;
+			continue;
+		}
+		if (!(cfg->flags[pc] & CFG_CODE)) continue;
+		instructions++;
+		covered += pcCounts[pc] > 0;
+		if (!isConditional(rom[pc]) || pcCounts[pc] == 0) continue;
+		conditionals++;
+		both += takenCounts[pc] > 0 && notTakenCounts[pc] > 0;
+		neverTaken += takenCounts[pc] == 0;
+		neverNot += notTakenCounts[pc] == 0;
+	}
+	printf("%d sessions: %d of %d ROM instructions executed (%.1f%%), %d addresses outside the ROM\n",
+		sessions, covered, instructions, 100.0 * covered / instructions, ram);
+	printf("%d of %d executed conditionals went both ways, %d never taken, %d never fell through\n",
+		both, conditionals, neverTaken, neverNot);
+
+	if (listingName != NULL) {
+		FILE* out = fopen(listingName, "w");
+		if (out == NULL) {
+			printf("Could not write %s\n", listingName);
+			return 1;
+		}
+		writeListing(out, rom, cfg, sessions);
+		fclose(out);
+	}
+	freeCfg(cfg);
+	free(merged);
+	return 0;
+}
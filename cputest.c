@@ -0,0 +1,127 @@
+// runs the standard CP/M 8080 test programs (TST8080, 8080PRE, CPUTEST, 8080EXM)
+// on emulateOp8080 with just enough of a BDOS to print their output
+//
+// usage: ./cputest TST8080.COM 8080PRE.COM CPUTEST.COM 8080EXM.COM
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "platform.h"
+
+#define COM_START 0x0100
+#define BDOS 0x0005
+#define STACK_TOP 0xF000
+#define OUTPUT_SZ (1<<16)
+
+typedef struct TestRun {
+	char output[OUTPUT_SZ];
+	int outputLen;
+	uint64_t cycles;
+	uint64_t instructions;
+	int64_t nanos;
+	bool finished; // jumped back to 0 (warm boot) rather than halting
+} TestRun;
+
+static void putOutput(TestRun* run, char c) {
+	putchar(c);
+	if (run->outputLen < OUTPUT_SZ - 1) run->output[run->outputLen++] = c;
+}
+
+// the only two BDOS calls the test programs use
+static void bdos(State8080* state, TestRun* run) {
+	switch (state->regs[REG_C]) {
+		case 2:
+			// print the character in E
+			putOutput(run, state->regs[REG_E]);
+			break;
+		case 9:
+		{
+			// print the '$' terminated string at DE
+			u16 addr = (u16)state->regs[REG_D]<<8 | state->regs[REG_E];
+			for (u8 c; (c = readMem(state, addr)) != '$'; addr++) putOutput(run, c);
+			break;
+		}
+	}
+	fflush(stdout);
+}
+
+static bool loadCom(State8080* state, const char* filename) {
+	FILE* f = fopen(filename, "rb");
+	if (f == NULL) {
+		printf("Error loading file: %s\n", filename);
+		return false;
+	}
+	fread(state->memory + COM_START, 1, MEM_SZ - COM_START, f);
+	fclose(f);
+	// warm boot at 0 is trapped, BDOS at 5 is trapped then returns,
+	// and programs that set SP from the BDOS address at 6 get STACK_TOP
+	state->memory[BDOS] = 0xC9; // RET
+	state->memory[BDOS+1] = STACK_TOP & 0xFF;
+	state->memory[BDOS+2] = STACK_TOP >> 8;
+	state->pc = COM_START;
+	state->sp = STACK_TOP;
+	// no interrupt source here, but make sure nothing is latched
+	state->interruptsEnabled = false;
+	return true;
+}
+
+static void runCom(State8080* state, Machine* machine, TestRun* run) {
+	int64_t start = currNano();
+	while (true) {
+		if (state->pc == BDOS) bdos(state, run);
+		else if (state->pc == 0x0000) {
+			run->finished = true;
+			break;
+		}
+		if (state->halted) break;
+		run->cycles += nextOp8080(state, machine);
+		run->instructions++;
+	}
+	run->nanos = currNano() - start;
+}
+
+// the programs print different things on success, but all of them say ERROR or FAIL(ED) when something is wrong
+static bool passed(TestRun* run) {
+	if (!run->finished) return false;
+	run->output[run->outputLen] = '\0';
+	for (char* p = run->output; *p; p++) {
+		if (!strncasecmp(p, "ERROR", 5) || !strncasecmp(p, "FAIL", 4)) return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("usage: %s PROGRAM.COM...\n", argv[0]);
+		return 1;
+	}
+	int failures = 0;
+	TestRun* runs = calloc(argc, sizeof(TestRun));
+	for (int i = 1; i < argc; i++) {
+		State8080* state = initState8080();
+		Machine* machine = initMachine();
+		printf("=== %s\n", argv[i]);
+		if (loadCom(state, argv[i])) runCom(state, machine, &runs[i]);
+		printf("\n");
+		freeState8080(state);
+		free(machine);
+	}
+
+	printf("\n");
+	for (int i = 1; i < argc; i++) {
+		TestRun* run = &runs[i];
+		bool ok = passed(run);
+		if (!ok) failures++;
+		double secs = run->nanos / 1e9;
+		printf("%-4s %-20s %12llu cycles %12llu instructions %8.3f s %10.1f Mcycles/s\n",
+				ok ? "PASS" : "FAIL", argv[i],
+				(unsigned long long)run->cycles, (unsigned long long)run->instructions,
+				secs, secs > 0 ? run->cycles / secs / 1e6 : 0.0);
+	}
+	free(runs);
+	return failures == 0 ? 0 : 1;
+}
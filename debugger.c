@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "debugger.h"
+#include "disassemble.h"
+#include "emulate8080.h"
+#include "machine.h"
+
+static inline bool isBreakpoint(Debugger* dbg, u16 pc) {
+	return (dbg->breakpoints[pc>>3] >> (pc&7)) & 1;
+}
+
+// what a read of addr sees, the same byte for every address that aliases it
+static const u8* watchByte(State8080* state, u16 addr) {
+	return state->rbase[addr >> PAGE_SHIFT] + (addr & (PAGE_SZ-1));
+}
+
+static void watchTrap(State8080* state, u16 addr, u8 val, bool write) {
+	Debugger* dbg = state->trapData;
+	const u8* byte = watchByte(state, addr);
+	for (int i = 0; i < dbg->numWatchpoints; i++) {
+		Watchpoint* w = &dbg->watchpoints[i];
+		if (w->byte == byte && (w->kind & (write ? WATCH_W : WATCH_R))) {
+			// the access still completes, we stop after the instruction
+			dbg->stopped = true;
+			dbg->hitWatch = true;
+			dbg->hitAddr = addr;
+			dbg->hitVal = val;
+			dbg->hitWrite = write;
+			return;
+		}
+	}
+}
+
+// works out which trap flags the pages holding addr's byte need from the watchpoints still
+// on it, on every page that maps it (mirrors copy their flags only when they're mapped)
+static void refreshWatchPage(Debugger* dbg, u16 addr) {
+	State8080* state = dbg->state;
+	const u8* page = state->rbase[addr >> PAGE_SHIFT];
+	u8 flags = 0;
+	for (int i = 0; i < dbg->numWatchpoints; i++) {
+		const u8* byte = dbg->watchpoints[i].byte;
+		if (byte < page || byte >= page + PAGE_SZ) continue;
+		if (dbg->watchpoints[i].kind & WATCH_R) flags |= PAGE_TRAP_R;
+		if (dbg->watchpoints[i].kind & WATCH_W) flags |= PAGE_TRAP_W;
+	}
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (state->rbase[p] != page) continue;
+		clearPageFlags8080(state, p << PAGE_SHIFT, (p + 1) << PAGE_SHIFT, PAGE_TRAP_R | PAGE_TRAP_W);
+		setPageFlags8080(state, p << PAGE_SHIFT, (p + 1) << PAGE_SHIFT, flags);
+	}
+}
+
+Debugger* initDebugger(State8080* state, Machine* machine) {
+	Debugger* dbg = malloc(sizeof(Debugger));
+	memset(dbg, 0, sizeof(Debugger));
+	dbg->state = state;
+	dbg->machine = machine;
+	state->memTrap = watchTrap;
+	state->trapData = dbg;
+	return dbg;
+}
+
+void freeDebugger(Debugger* dbg) {
+	while (dbg->numWatchpoints > 0) removeWatchpoint(dbg, dbg->watchpoints[0].addr);
+	dbg->state->memTrap = NULL;
+	dbg->state->trapData = NULL;
+	free(dbg);
+}
+
+void setBreakpoint(Debugger* dbg, u16 pc) {
+	dbg->breakpoints[pc>>3] |= 1<<(pc&7);
+}
+
+void clearBreakpoint(Debugger* dbg, u16 pc) {
+	dbg->breakpoints[pc>>3] &= ~(1<<(pc&7));
+}
+
+bool addWatchpoint(Debugger* dbg, u16 addr, u8 kind) {
+	for (int i = 0; i < dbg->numWatchpoints; i++) {
+		if (dbg->watchpoints[i].addr == addr) {
+			dbg->watchpoints[i].kind = kind;
+			refreshWatchPage(dbg, addr);
+			return true;
+		}
+	}
+	if (dbg->numWatchpoints == MAX_WATCHPOINTS) return false;
+	dbg->watchpoints[dbg->numWatchpoints].addr = addr;
+	dbg->watchpoints[dbg->numWatchpoints].kind = kind;
+	dbg->watchpoints[dbg->numWatchpoints].byte = watchByte(dbg->state, addr);
+	dbg->numWatchpoints++;
+	refreshWatchPage(dbg, addr);
+	return true;
+}
+
+void removeWatchpoint(Debugger* dbg, u16 addr) {
+	for (int i = 0; i < dbg->numWatchpoints; i++) {
+		if (dbg->watchpoints[i].addr == addr) {
+			dbg->watchpoints[i] = dbg->watchpoints[--dbg->numWatchpoints];
+			break;
+		}
+	}
+	refreshWatchPage(dbg, addr);
+}
+
+static void clearTemp(Debugger* dbg) {
+	if (!dbg->tempActive) return;
+	if (!dbg->tempWasSet) clearBreakpoint(dbg, dbg->tempPc);
+	dbg->tempActive = false;
+}
+
+int debugRun(Debugger* dbg, int cycles) {
+	State8080* state = dbg->state;
+	int ran = 0;
+	dbg->stopped = false;
+	dbg->hitWatch = false;
+	// the first instruction always runs so continuing off a breakpoint works
+	bool first = true;
+	while (ran < cycles && state->on) {
+		if (!first && isBreakpoint(dbg, state->pc)) {
+			dbg->stopped = true;
+			break;
+		}
+		first = false;
+		ran += nextOp8080(state, dbg->machine);
+		if (dbg->stopped) break;
+	}
+	if (dbg->stopped && dbg->tempActive && state->pc == dbg->tempPc) clearTemp(dbg);
+	return ran;
+}
+
+int debugStep(Debugger* dbg) {
+	dbg->hitWatch = false;
+	int ans = nextOp8080(dbg->state, dbg->machine);
+	dbg->stopped = true;
+	return ans;
+}
+
+void debugStepOver(Debugger* dbg) {
+	State8080* state = dbg->state;
+	u8 op = fetchMem(state, state->pc);
+	// CALL, Ccc and RST come back to the next instruction, anything else is a plain step
+	bool call = op == 0xCD || (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7;
+	if (!call) {
+		debugStep(dbg);
+		return;
+	}
+	clearTemp(dbg);
+	char buffer[64];
+	dbg->tempPc = state->pc + disassemble8080(buffer, op, fetchMem(state, state->pc+1), fetchMem(state, state->pc+2), state->pc);
+	dbg->tempWasSet = isBreakpoint(dbg, dbg->tempPc);
+	dbg->tempActive = true;
+	setBreakpoint(dbg, dbg->tempPc);
+	dbg->stopped = false;
+}
+
+void printRegisters(Debugger* dbg) {
+	State8080* state = dbg->state;
+	u8* r = state->regs;
+	u8 psw = state->psw;
+	printf("PC %04X  SP %04X  A %02X  B %02X C %02X  D %02X E %02X  H %02X L %02X  ",
+			state->pc, state->sp, r[REG_A], r[REG_B], r[REG_C], r[REG_D], r[REG_E], r[REG_H], r[REG_L]);
+	printf("F %02X [%c%c%c%c%c]%s%s\n", psw,
+			(psw>>FLAG_S & 1) ? 'S' : '-',
+			(psw>>FLAG_Z & 1) ? 'Z' : '-',
+			(psw>>FLAG_AC & 1) ? 'A' : '-',
+			(psw>>FLAG_P & 1) ? 'P' : '-',
+			(psw>>FLAG_C & 1) ? 'C' : '-',
+			state->interruptsEnabled ? " EI" : " DI",
+			state->halted ? " HALTED" : "");
+}
+
+// fetchMem so looking at memory never fires a watchpoint
+void printMemory(Debugger* dbg, u16 addr, int len) {
+	for (int i = 0; i < len; i += 16) {
+		printf("%04X ", (u16)(addr + i));
+		for (int j = i; j < i + 16 && j < len; j++) printf(" %02X", fetchMem(dbg->state, addr + j));
+		printf("\n");
+	}
+}
+
+void printListing(Debugger* dbg, u16 addr, int n) {
+	char buffer[64];
+	for (int i = 0; i < n; i++) {
+		u8 op = fetchMem(dbg->state, addr);
+		int sz = disassemble8080(buffer, op, fetchMem(dbg->state, addr+1), fetchMem(dbg->state, addr+2), addr);
+		printf("%c%c %04X\t%s\n", addr == dbg->state->pc ? '>' : ' ', isBreakpoint(dbg, addr) ? '*' : ' ', addr, buffer);
+		addr += sz;
+	}
+}
+
+static void printHelp() {
+	printf("c              continue\n");
+	printf("s [n]          step n instructions\n");
+	printf("n              step over calls\n");
+	printf("b addr         set breakpoint\n");
+	printf("bd addr        delete breakpoint\n");
+	printf("bl             list breakpoints and watchpoints\n");
+	printf("w addr [r|w]   watch reads and/or writes (default both)\n");
+	printf("wd addr        delete watchpoint\n");
+	printf("r              registers\n");
+	printf("m addr [len]   memory\n");
+	printf("l [addr] [n]   disassembly\n");
+	printf("q              quit\n");
+}
+
+bool debugPrompt(Debugger* dbg) {
+	char line[256], cmd[16], arg[16];
+	unsigned int a, b;
+	if (dbg->hitWatch) {
+		printf("watchpoint: %s %04X = %02X\n", dbg->hitWrite ? "write" : "read", dbg->hitAddr, dbg->hitVal);
+	}
+	printRegisters(dbg);
+	printListing(dbg, dbg->state->pc, 1);
+	while (true) {
+		printf("(dbg) ");
+		fflush(stdout);
+		if (fgets(line, sizeof(line), stdin) == NULL) return false;
+		int n = sscanf(line, "%15s %x %15s", cmd, &a, arg);
+		if (n <= 0) continue;
+		if (!strcmp(cmd, "c")) {
+			return true;
+		}
+		else if (!strcmp(cmd, "s")) {
+			if (sscanf(line, "%*s %u", &a) != 1) a = 1;
+			for (unsigned int i = 0; i < a; i++) {
+				debugStep(dbg);
+				if (dbg->hitWatch) break;
+			}
+			if (dbg->hitWatch) printf("watchpoint: %s %04X = %02X\n", dbg->hitWrite ? "write" : "read", dbg->hitAddr, dbg->hitVal);
+			printRegisters(dbg);
+			printListing(dbg, dbg->state->pc, 1);
+		}
+		else if (!strcmp(cmd, "n")) {
+			debugStepOver(dbg);
+			if (!dbg->stopped) return true;
+			printRegisters(dbg);
+			printListing(dbg, dbg->state->pc, 1);
+		}
+		else if (!strcmp(cmd, "b") && n >= 2) {
+			setBreakpoint(dbg, a);
+		}
+		else if (!strcmp(cmd, "bd") && n >= 2) {
+			clearBreakpoint(dbg, a);
+		}
+		else if (!strcmp(cmd, "bl")) {
+			for (int i = 0; i < MEM_SZ; i++) {
+				if (isBreakpoint(dbg, i)) printf("break %04X\n", i);
+			}
+			for (int i = 0; i < dbg->numWatchpoints; i++) {
+				Watchpoint* w = &dbg->watchpoints[i];
+				printf("watch %04X %s%s\n", w->addr, (w->kind & WATCH_R) ? "r" : "", (w->kind & WATCH_W) ? "w" : "");
+			}
+		}
+		else if (!strcmp(cmd, "w") && n >= 2) {
+			u8 kind = WATCH_R | WATCH_W;
+			if (n == 3) kind = (strchr(arg, 'r') ? WATCH_R : 0) | (strchr(arg, 'w') ? WATCH_W : 0);
+			if (!addWatchpoint(dbg, a, kind)) printf("too many watchpoints (max %d)\n", MAX_WATCHPOINTS);
+		}
+		else if (!strcmp(cmd, "wd") && n >= 2) {
+			removeWatchpoint(dbg, a);
+		}
+		else if (!strcmp(cmd, "r")) {
+			printRegisters(dbg);
+		}
+		else if (!strcmp(cmd, "m") && n >= 2) {
+			if (sscanf(line, "%*s %*x %x", &b) != 1) b = 0x40;
+			printMemory(dbg, a, b);
+		}
+		else if (!strcmp(cmd, "l")) {
+			if (n < 2) a = dbg->state->pc;
+			if (sscanf(line, "%*s %*x %u", &b) != 1) b = 16;
+			printListing(dbg, a, b);
+		}
+		else if (!strcmp(cmd, "q")) {
+			return false;
+		}
+		else {
+			printHelp();
+		}
+	}
+}
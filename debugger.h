@@ -0,0 +1,64 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+#define MAX_WATCHPOINTS 16
+
+enum WatchKind {
+	WATCH_R=1, WATCH_W=2
+};
+
+typedef struct Watchpoint {
+	u16 addr;
+	u8 kind;
+	const u8* byte; // where addr lives, so it fires through any mirror of it too
+} Watchpoint;
+
+typedef struct Debugger {
+	State8080* state;
+	Machine* machine;
+	// one bit per PC, only looked at by debugRun so ordinary runs never touch it
+	u8 breakpoints[MEM_SZ/8];
+	Watchpoint watchpoints[MAX_WATCHPOINTS];
+	int numWatchpoints;
+	bool stopped;
+	// what stopped us, for the prompt
+	bool hitWatch;
+	u16 hitAddr;
+	u8 hitVal;
+	bool hitWrite;
+	// step over plants a one shot breakpoint after the call
+	bool tempActive;
+	u16 tempPc;
+	bool tempWasSet;
+} Debugger;
+
+// takes over state->memTrap while attached
+Debugger* initDebugger(State8080* state, Machine* machine);
+void freeDebugger(Debugger* dbg);
+
+void setBreakpoint(Debugger* dbg, u16 pc);
+void clearBreakpoint(Debugger* dbg, u16 pc);
+bool addWatchpoint(Debugger* dbg, u16 addr, u8 kind);
+void removeWatchpoint(Debugger* dbg, u16 addr);
+
+// runs for up to cycles cycles, stopping early on a breakpoint or watchpoint
+// returns the number of cycles actually run
+int debugRun(Debugger* dbg, int cycles);
+int debugStep(Debugger* dbg);
+void debugStepOver(Debugger* dbg);
+
+void printRegisters(Debugger* dbg);
+void printMemory(Debugger* dbg, u16 addr, int len);
+void printListing(Debugger* dbg, u16 addr, int n);
+
+// reads commands from stdin until the user continues
+// returns false if they asked to quit
+bool debugPrompt(Debugger* dbg);
+
+#endif
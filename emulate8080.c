@@ -10,6 +10,7 @@
 #include "emulate8080.h"
 #include "machine.h"
 #include "platform.h"
+#include "ops8080.h"
 
 #define ROM_SIZE 0x10000
 
@@ -19,205 +20,266 @@ FILE* disassembleFile;
 char disassembledProgram[ROM_SIZE][50];
 int opsizes[ROM_SIZE];
 
-u8 parityLookup[256];
-
-State8080* initState8080() {
-	for (int i = 0; i < 256; i++) {
-		u8 ans = 1;
-		u8 j = i;
-		while (j > 0) {
-			ans ^= (j & 1);
-			j >>= 1;
-		}
-		parityLookup[i] = ans;
-	}
-	State8080* state = malloc(sizeof(State8080));
-	memset(state->memory, 0, MEM_SZ);
+// 1 for an even number of set bits, built by the preprocessor so there's nothing to set up per instance
+#define PARITY2(n) (n), (n) ^ 1, (n) ^ 1, (n)
+#define PARITY4(n) PARITY2(n), PARITY2((n) ^ 1), PARITY2((n) ^ 1), PARITY2(n)
+#define PARITY6(n) PARITY4(n), PARITY4((n) ^ 1), PARITY4((n) ^ 1), PARITY4(n)
+const u8 parityLookup[256] = {PARITY6(1), PARITY6(0), PARITY6(0), PARITY6(1)};
+
+// cycles per opcode (states, per the 8080 manual), conditional calls and returns
+// take the longer count from opCyclesTaken when the condition holds
+const u8 opCycles[256] = {
+//	x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 0x
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 1x
+	 4, 10, 16,  5,  5,  5,  7,  4,  4, 10, 16,  5,  5,  5,  7,  4, // 2x
+	 4, 10, 13,  5, 10, 10, 10,  4,  4, 10, 13,  5,  5,  5,  7,  4, // 3x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 4x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 5x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 6x
+	 7,  7,  7,  7,  7,  7,  7,  7,  5,  5,  5,  5,  5,  5,  7,  5, // 7x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 8x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 9x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Ax
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Bx
+	 5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Cx
+	 5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Dx
+	 5, 10, 10, 18, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11, // Ex
+	 5, 10, 10,  4, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11, // Fx
+};
+
+const u8 opCyclesTaken[256] = {
+//	x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 0x
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 1x
+	 4, 10, 16,  5,  5,  5,  7,  4,  4, 10, 16,  5,  5,  5,  7,  4, // 2x
+	 4, 10, 13,  5, 10, 10, 10,  4,  4, 10, 13,  5,  5,  5,  7,  4, // 3x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 4x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 5x
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 6x
+	 7,  7,  7,  7,  7,  7,  7,  7,  5,  5,  5,  5,  5,  5,  7,  5, // 7x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 8x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 9x
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Ax
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Bx
+	11, 10, 10, 10, 17, 11,  7, 11, 11, 10, 10, 10, 17, 17,  7, 11, // Cx
+	11, 10, 10, 10, 17, 11,  7, 11, 11, 10, 10, 10, 17, 17,  7, 11, // Dx
+	11, 10, 10, 18, 17, 11,  7, 11, 11,  5, 10,  4, 17, 17,  7, 11, // Ex
+	11, 10, 10,  4, 17, 11,  7, 11, 11,  5, 10,  4, 17, 17,  7, 11, // Fx
+};
+
+
+void setupState8080(State8080* state, u8* memory) {
+	state->memory = memory;
+	memset(state->memory, 0, MEM_ALLOC_SZ);
 	memset(state->regs, 0, 8);
 	state->psw = 2;
+	state->pc = 0;
 	state->sp = 0;
 	state->halted = false;
+	state->interruptPending = false;
 	state->interrupted = false;
+	state->eiDelay = false;
+	atomic_init(&state->interruptRequest, 0);
+	state->idleSkip = false;
+	state->idleArmed = false;
+	state->idleCycles = 0;
+	state->engineData = NULL;
+	state->ramHashed = false;
+	state->ramHash = 0;
+	state->executed = NULL;
+	state->branches = NULL;
 	state->interruptsEnabled = true;
 	state->on = true;
 
 	state->interruptbus[0] = 0;
 	state->interruptbus[1] = 0;
 	state->interruptbus[2] = 0;
-	return state;
-}
 
-static inline void writeMem(State8080* state, u16 addr, u8 val) {
-	//if (SPACE_INVADERS_MEM_SAFETY && addr < 0x2000) {
-//		printf("Cannot write address %X (ROM is addresses < 0x2000) (PC: %X)\n", addr, state->pc);
-//	}
-//	else {
-		state->memory[addr] = val;
-//	}
+	// flat 64 KB of RAM until a machine maps something else
+	memset(state->pageFlags, 0, NUM_PAGES);
+	state->memTrap = NULL;
+	state->trapData = NULL;
+	mapMemory8080(state, 0, MEM_SZ, state->memory, state->memory);
 }
 
-void generateInterrupt(State8080* state, u8 opcode, u8 data1, u8 data2) {
-	state->interruptbus[0] = opcode;
-	state->interruptbus[1] = data1;
-	state->interruptbus[2] = data2;
-	state->interrupted = true;
+State8080* initState8080() {
+	State8080* state = aligned_alloc(64, sizeof(State8080));
+	// whole pages, so a copy of the work RAM or VRAM never shares a line with anything else
+	u8* memory;
+	if (posix_memalign((void**)&memory, MEM_ALIGN, MEM_ALLOC_SZ) != 0) {
+		printf("Could not allocate 8080 memory\n");
+		exit(1);
+	}
+	setupState8080(state, memory);
+	return state;
 }
 
-static inline u16 combine8(u8 lo, u8 hi) {
-	return (u16)hi<<8 | lo;
+void freeState8080(State8080* state) {
+	free(state->memory);
+	free(state);
 }
 
-int stack_size = 0;
-static inline void push8(State8080* state, u8 val) {
-	writeMem(state, --state->sp, val);
-}
-static inline void push16(State8080* state, u16 val) {
-	push8(state, (u8)(val>>8 & 0xFF));
-	push8(state, (u8)(val & 0xFF));
+static void refreshPage(State8080* state, int p) {
+	state->rpage[p] = (state->pageFlags[p] & PAGE_TRAP_R) ? NULL : state->rbase[p];
+	state->wpage[p] = (state->pageFlags[p] & (PAGE_TRAP_W | PAGE_HASH)) ? NULL : state->wbase[p];
 }
 
-static inline u8 pop8(State8080* state) {
-	return state->memory[state->sp++];
-}
-static inline u16 pop16(State8080* state) {
-	u8 lo = pop8(state);
-	u8 hi = pop8(state);
-	return combine8(lo, hi);
+void mapMemory8080(State8080* state, int start, int end, const u8* read, u8* write) {
+	for (int p = start >> PAGE_SHIFT; p < end >> PAGE_SHIFT; p++) {
+		int off = (p << PAGE_SHIFT) - start;
+		state->rbase[p] = read + off;
+		if (write != NULL) {
+			state->wbase[p] = write + off;
+			state->pageFlags[p] &= ~PAGE_ROM;
+		}
+		else {
+			state->wbase[p] = state->sinkPage;
+			state->pageFlags[p] |= PAGE_ROM;
+		}
+		refreshPage(state, p);
+	}
 }
 
-// rp = 0b11 can be either SP or PSW (A + status)
-u8* dRegHi(State8080* state, u8 rp, bool psw) {
-	if (rp < 3) return &(state->regs[rp*2]);
-	else if (psw) return &(state->regs[REG_A]);
-	else return (u8*)(&(state->sp)) + 1; // little-endian!!!
-}
-u8* dRegLo(State8080* state, u8 rp, bool psw) {
-	if (rp < 3) return &(state->regs[rp*2 + 1]);
-	else if (psw) return &(state->psw);
-	else return (u8*)(&(state->sp));
+void mirrorMemory8080(State8080* state, int start, int end, int src) {
+	int s = src >> PAGE_SHIFT;
+	for (int p = start >> PAGE_SHIFT; p < end >> PAGE_SHIFT; p++, s++) {
+		state->rbase[p] = state->rbase[s];
+		state->wbase[p] = state->wbase[s];
+		state->pageFlags[p] = state->pageFlags[s];
+		refreshPage(state, p);
+	}
 }
 
-static inline u8 readReg(State8080* state, int reg) {
-	if (reg == REG_M) return state->memory[combine8(readReg(state, REG_L), readReg(state, REG_H))];
-	else return state->regs[reg];
-}
-static inline void writeReg(State8080* state, int reg, u8 val) {
-	if (reg == REG_M) writeMem(state, combine8(readReg(state, REG_L), readReg(state, REG_H)), val);
-	else state->regs[reg] = val;
-}
-// b 0 or 1
-static inline void setFlag(State8080* state, enum Flag f, u8 b) {
-	state->psw = (state->psw & ~(1<<f)) | (b<<f);
-}
-static inline int getFlag(State8080* state, enum Flag f) {
-	return (state->psw >> f) & 1;
+void setPageFlags8080(State8080* state, int start, int end, u8 flags) {
+	for (int p = start >> PAGE_SHIFT; p < end >> PAGE_SHIFT; p++) {
+		state->pageFlags[p] |= flags;
+		refreshPage(state, p);
+	}
 }
 
-static inline void setSign(State8080* state, u8 val) {
-	setFlag(state, FLAG_S, (val>>7));
-}
-static inline void setZero(State8080* state, u8 val) {
-	setFlag(state, FLAG_Z, val == 0);
-}
-static inline void setParity(State8080* state, u8 val) {
-	/*
-	u8 ans = 1;
-	while (val > 0) {
-		ans ^= (val & 1);
-		val >>= 1;
+void clearPageFlags8080(State8080* state, int start, int end, u8 flags) {
+	for (int p = start >> PAGE_SHIFT; p < end >> PAGE_SHIFT; p++) {
+		state->pageFlags[p] &= ~flags;
+		refreshPage(state, p);
 	}
-	*/
-	setFlag(state, FLAG_P, parityLookup[val]);
 }
-void setNonCarryFlags(State8080* state, u8 val) {
-	setSign(state, val);
-	setZero(state, val);
-	setParity(state, val);
+
+// a page is hashed if it writes somewhere in memory, the hash covers the pages written to
+static bool ramPage(const State8080* state, int p) {
+	return !(state->pageFlags[p] & PAGE_ROM) && state->wbase[p] >= state->memory && state->wbase[p] < state->memory + MEM_SZ;
 }
 
-// ALU ops
-static inline u8 ALUadd(State8080* state, u8 x1, u8 x2, u8 carry) {
-	setFlag(state, FLAG_C, ((u16)x2+(u16)carry + (u16)x1 > 0xFF));
-	setFlag(state, FLAG_AC, (((x1 & 0xF) + (x2 & 0xF) + carry) & 0x10));
-	u8 y = (x1 + x2 + carry) & 0xFF;
-	setNonCarryFlags(state, y);
-	return y;
+uint64_t computeRamHash8080(const State8080* state) {
+	bool written[NUM_PAGES] = {false};
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (ramPage(state, p)) written[(state->wbase[p] - state->memory) >> PAGE_SHIFT] = true;
+	}
+	uint64_t hash = 0;
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (!written[p]) continue;
+		for (uint32_t a = p << PAGE_SHIFT; a < (uint32_t)(p + 1) << PAGE_SHIFT; a++) hash ^= ramByteHash(a, state->memory[a]);
+	}
+	return hash;
 }
 
-static inline u8 ALUsub(State8080* state, u8 x1, u8 x2, u8 carry) {
-	setFlag(state, FLAG_C, (u16)x2+(u16)carry > x1);
-	//setFlag(state, FLAG_AC, (x2 & 0xF) + (carry & 0xF) > (x1 & 0xF));
-	u8 y = (x1 - x2 - carry) & 0xFF;
-	setNonCarryFlags(state, y);
-	return y;
-	/*
-	some bs i stole from another guy's emulator cause i still don't understand how AC works in subtractions
-
-	u8 x2_ones = (~x2) & 0xFF;
-
-	u16 res16 = (u16)x1 + (u16)x2_ones + (u16)(carry ? 0 : 1);
-	u8 res8 = res16 & 0xFF;
-
-	setFlag(state, FLAG_C, !(res16 & 0x100));
-	setFlag(state, FLAG_AC, (((x1 & 0xF) + (x2_ones & 0xF) + (carry ? 0 : 1)) & 0x10)>>4);
-	setNonCarryFlags(state, res8);
-	*/
-	//printf("%X %X %X %X %X %X %X %X\n", x1, x2, carry, x2_ones, res16, res8, getFlag(state, FLAG_C), getFlag(state, FLAG_AC));
-	//return res8;
+void enableRamHash8080(State8080* state) {
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (ramPage(state, p)) setPageFlags8080(state, p << PAGE_SHIFT, (p + 1) << PAGE_SHIFT, PAGE_HASH);
+	}
+	state->ramHash = computeRamHash8080(state);
+	state->ramHashed = true;
 }
 
-u8 ALUand(State8080* state, u8 x1, u8 x2, bool affectAC) {
-	setFlag(state, FLAG_C, 0);
-	// LMAO
-	setFlag(state, FLAG_AC, affectAC & ((x1|x2)>>3));
-	u8 y = x1 & x2;
-	setNonCarryFlags(state, y);
-	return y;
+void disableRamHash8080(State8080* state) {
+	clearPageFlags8080(state, 0, MEM_SZ, PAGE_HASH);
+	state->ramHashed = false;
 }
 
-u8 ALUxor(State8080* state, u8 x1, u8 x2) {
-	setFlag(state, FLAG_C, 0);
-	setFlag(state, FLAG_AC, 0);
-	u8 y = x1 ^ x2;
-	setNonCarryFlags(state, y);
-	return y;
+// only trapped (or hashed) pages end up here
+u8 readMemSlow(State8080* state, u16 addr) {
+	u8 val = state->rbase[addr >> PAGE_SHIFT][addr & (PAGE_SZ-1)];
+	if (state->memTrap != NULL) state->memTrap(state, addr, val, false);
+	return val;
 }
 
-u8 ALUor(State8080* state, u8 x1, u8 x2) {
-	setFlag(state, FLAG_C, 0);
-	setFlag(state, FLAG_AC, 0);
-	u8 y = x1 | x2;
-	setNonCarryFlags(state, y);
-	return y;
+void writeMemSlow(State8080* state, u16 addr, u8 val) {
+	int p = addr >> PAGE_SHIFT;
+	if (state->memTrap != NULL && (state->pageFlags[p] & PAGE_TRAP_W)) state->memTrap(state, addr, val, true);
+	u8* byte = &state->wbase[p][addr & (PAGE_SZ-1)];
+	if (state->pageFlags[p] & PAGE_HASH) {
+		uint32_t offset = byte - state->memory;
+		state->ramHash ^= ramByteHash(offset, *byte) ^ ramByteHash(offset, val);
+	}
+	*byte = val;
 }
 
-void ALUcmp(State8080* state, u8 x1, u8 x2) {
-	ALUsub(state, x1, x2, 0);
+void generateInterrupt(State8080* state, u8 opcode, u8 data1, u8 data2) {
+	state->interruptbus[0] = opcode;
+	state->interruptbus[1] = data1;
+	state->interruptbus[2] = data2;
+	state->interruptPending = true;
+	if (state->interruptsEnabled) state->interrupted = true;
 }
 
-bool evaluateCC(State8080* state, u8 cc) {
-	switch (cc) {
+int stack_size = 0;
+
+// can this be in the body of an idle loop: no stores, no I/O, no stack, no control flow
+static bool idleSafe(u8 op) {
+	switch (op >> 6) {
 		case 0:
-			return !getFlag(state, FLAG_Z);
+			switch (op & 0xF) {
+				case 0x2: return false; // STAX, SHLD, STA
+				case 0x4: case 0x5: case 0x6: case 0xC: case 0xD: case 0xE:
+					return (op >> 3 & 7) != REG_M; // INR, DCR, MVI but not on M
+			}
+			return true;
 		case 1:
-			return getFlag(state, FLAG_Z);
+			return (op >> 3 & 7) != REG_M; // MOV but not into M (or HLT)
 		case 2:
-			return !getFlag(state, FLAG_C);
+			return true; // ALU with register
 		case 3:
-			return getFlag(state, FLAG_C);
-		case 4:
-			return !getFlag(state, FLAG_P);
-		case 5:
-			return getFlag(state, FLAG_P);
-		case 6:
-			return !getFlag(state, FLAG_S);
-		case 7:
-			return getFlag(state, FLAG_S);
+			return (op & 7) == 6 || op == 0xEB; // ALU immediate, XCHG
+	}
+	return false;
+}
+
+// cycles per trip round the loop [head, branch] if it's straight line code that can't
+// change anything but registers, otherwise 0
+static int idleLoopCycles(State8080* state, u16 head, u16 branch) {
+	int cycles = 0;
+	u16 pc = head;
+	while (pc != branch) {
+		u8 op = fetchMem(state, pc);
+		if ((u16)(pc - head) > MAX_IDLE_LOOP || !idleSafe(op)) return 0;
+		cycles += opCycles[op];
+		pc += opSize8080(op);
 	}
+	return cycles + opCycles[fetchMem(state, branch)];
+}
+
+// called on every taken backward JMP/Jcc when idleSkip is on
+// two trips round the same loop ending in the same registers, with nothing in between but
+// the (side effect free) loop body, means it will keep doing exactly that until an interrupt
+static void noteBackwardJump(State8080* state, u16 from) {
+	if (state->idleArmed && state->idleHead == state->pc && state->idleFrom == from
+			&& !memcmp(state->idleRegs, state->regs, 8) && state->idlePsw == state->psw && state->idleSp == state->sp
+			&& state->memTrap == NULL) {
+		state->idleCycles = idleLoopCycles(state, state->pc, from);
+		return;
+	}
+	state->idleArmed = true;
+	state->idleHead = state->pc;
+	state->idleFrom = from;
+	memcpy(state->idleRegs, state->regs, 8);
+	state->idlePsw = state->psw;
+	state->idleSp = state->sp;
+	state->idleCycles = 0;
 }
 
 // return is number of cycles taken
-int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
+// always inlined so callers with a constant op (the handlers below) get just that case
+static inline __attribute__((always_inline)) int execOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 	// pickin out various parts of the opcode
 	// "b" is an arbitrary bit in what follows
 	// reg1 and reg2 are three bits long, where 8 bits are bb-reg1-reg2
@@ -225,6 +287,8 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 	// f2 is the first two bits of the opcode (f2-bb-bbbb)
 	// l4 is the second nibble (last 4 bits) (bbbb-l4);
 	u8 reg1, reg2, rp, f2, l4;
+	// where this instruction started (for jumps)
+	u16 oldpc = state->pc - 1;
 	reg1 = op >> 3 & 7;
 	reg2 = op & 7;
 	rp = op >> 4 & 3;
@@ -233,10 +297,24 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 	
 	// no parameter ops
 	switch (op) {
+		// undocumented aliases of NOP, JMP, RET and CALL
+		case 0x08: case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+			return opCycles[op];
+		case 0xCB:
+			state->pc = combine8(d1, d2);
+			return opCycles[op];
+		case 0xD9:
+			state->pc = pop16(state);
+			return opCycles[op];
+		case 0xDD: case 0xED: case 0xFD:
+			state->pc += 2;
+			push16(state, state->pc);
+			state->pc = combine8(d1, d2);
+			return opCycles[op];
 		case 0x00:
 		{
 			// NOP
-			return 4;
+			return opCycles[op];
 		}
 		case 0x07:
 		{
@@ -247,7 +325,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			state->regs[REG_A] <<= 1;
 			// set 0th bit to 7th bit
 			state->regs[REG_A] = (state->regs[REG_A] & ~1) | a7;
-			return 4;
+			return opCycles[op];
 		}
 		case 0x0F: 
 		{
@@ -257,7 +335,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			setFlag(state, FLAG_C, a0);
 			state->regs[REG_A] >>= 1;
 			state->regs[REG_A] = state->regs[REG_A] | (a0<<7);
-			return 4;
+			return opCycles[op];
 		}
 		case 0x17:
 		{
@@ -267,7 +345,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			setFlag(state, FLAG_C, state->regs[REG_A]>>7 & 1);
 			state->regs[REG_A] <<= 1;
 			state->regs[REG_A] = (state->regs[REG_A] & ~1) | cry;
-			return 4;
+			return opCycles[op];
 		}
 		case 0x1F:
 		{
@@ -277,7 +355,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			setFlag(state, FLAG_C, state->regs[REG_A] & 1);
 			state->regs[REG_A] >>= 1;
 			state->regs[REG_A] = state->regs[REG_A] | (cry << 7); 
-			return 4;
+			return opCycles[op];
 		}
 		case 0x22:
 		{
@@ -287,14 +365,14 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			writeMem(state, add++, state->regs[REG_L]);
 			writeMem(state, add, state->regs[REG_H]);
 			state->pc += 2;
-			return 16;
+			return opCycles[op];
 		}
 		case 0x27:
 		{
 			// DAA
 			// If low nibble of A is > 9 OR AC == 1 then A += 6
 			// then if high nibble of A is > 9 OR Cy == 1 then A += 0x60
-			//return 4;
+			//return opCycles[op];
 			if ((state->regs[REG_A] & 0x0F) > 9 || getFlag(state, FLAG_AC)) {
 				u8 oldcy = getFlag(state, FLAG_C);
 				u8 oldac = getFlag(state, FLAG_AC);
@@ -307,24 +385,24 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 				state->regs[REG_A] = ALUadd(state, state->regs[REG_A], 0x60, 0);
 				if (oldcy == 1) setFlag(state, FLAG_C, oldcy);
 			}
-			return 4;
+			return opCycles[op];
 		}
 		case 0x2A:
 		{
 			// LHLD add
 			// load contents at add into HL
 			u16 add = combine8(d1, d2);
-			state->regs[REG_L] = state->memory[add++];
-			state->regs[REG_H] = state->memory[add++];
+			state->regs[REG_L] = readMem(state, add++);
+			state->regs[REG_H] = readMem(state, add);
 			state->pc += 2;
-			return 16;
+			return opCycles[op];
 		}
 		case 0x2F:
 		{
 			// CMA
 			// A = not A
 			state->regs[REG_A] = ~state->regs[REG_A];
-			return 4;
+			return opCycles[op];
 		}
 		case 0x32:
 		{
@@ -332,49 +410,50 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			// put A at add
 			writeMem(state, combine8(d1, d2), state->regs[REG_A]);
 			state->pc += 2;
-			return 13;
+			return opCycles[op];
 		}
 		case 0x37:
 		{
 			// STC
 			// Set carry bit
 			setFlag(state, FLAG_C, 1);
-			return 4;
+			return opCycles[op];
 		}
 		case 0x3A:
 		{
 			// LDA add
 			// put contents at add into A
-			state->regs[REG_A] = state->memory[combine8(d1, d2)];
+			state->regs[REG_A] = readMem(state, combine8(d1, d2));
 			state->pc += 2;
-			return 13;
+			return opCycles[op];
 		}
 		case 0x3F:
 		{
 			// CMC
 			// Flip carry bit
 			setFlag(state, FLAG_C, !getFlag(state, FLAG_C));
-			return 4;
+			return opCycles[op];
 		}
 		case 0x76:
 		{
 			// HLT
 			// halt until interrupt
 			state->halted = true;
-			return 7;
+			return opCycles[op];
 		}
 		case 0xC3:
 		{
 			// JMP add
 			state->pc = combine8(d1, d2);
-			return 10;
+			if (__builtin_expect(state->idleSkip, 0) && state->pc < oldpc) noteBackwardJump(state, oldpc);
+			return opCycles[op];
 		}
 		case 0xC9:
 		{
 			// RET
 			// pop off stack into pc
 			state->pc = pop16(state);
-			return 10;
+			return opCycles[op];
 		}
 		case 0xCD:
 		{
@@ -383,7 +462,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			state->pc += 2;
 			push16(state, state->pc);
 			state->pc = combine8(d1, d2);
-			return 17;
+			return opCycles[op];
 		}
 		case 0xD3:
 		{
@@ -392,7 +471,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			writePort(machine, d1, state->regs[REG_A]);
 			//writePort2(d1, state->regs[REG_A]);
 			state->pc += 1;
-			return 10;
+			return opCycles[op];
 		}
 		case 0xDB:
 		{
@@ -401,7 +480,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			state->regs[REG_A] = readPort(machine, d1);
 			//state->regs[REG_A] = readPort2(d1);
 			state->pc += 1;
-			return 10;
+			return opCycles[op];
 		}
 		case 0xE3:
 		{
@@ -411,14 +490,14 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			push16(state, combine8(state->regs[REG_L], state->regs[REG_H]));
 			state->regs[REG_H] = st>>8 & 0xFF;
 			state->regs[REG_L] = st & 0xFF;
-			return 18;
+			return opCycles[op];
 		}
 		case 0xE9:
 		{
 			// PCHL
 			// jump to HL
 			state->pc = combine8(state->regs[REG_L], state->regs[REG_H]);
-			return 5;
+			return opCycles[op];
 		}
 		case 0xEB:
 		{
@@ -430,26 +509,26 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			state->regs[REG_L] = state->regs[REG_E];
 			state->regs[REG_D] = h;
 			state->regs[REG_E] = l;
-			return 4;
+			return opCycles[op];
 		}
 		case 0xF3:
 		{
 			// DI
-			state->interruptsEnabled = false;
-			return 4;
+			disableInterrupts8080(state);
+			return opCycles[op];
 		}
 		case 0xF9:
 		{
 			// SPHL
 			// make the stack pointer HL
 			state->sp = combine8(state->regs[REG_L], state->regs[REG_H]);
-			return 5;
+			return opCycles[op];
 		}
 		case 0xFB:
 		{
 			// EI
-			state->interruptsEnabled = true;
-			return 4;
+			enableInterrupts8080(state);
+			return opCycles[op];
 		}
 	}
 	// 16-bit (i.e. double) register operations
@@ -463,7 +542,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					*dRegLo(state, rp, false) = d1;
 					*dRegHi(state, rp, false) = d2;
 					state->pc += 2;
-					return 10;
+					return opCycles[op];
 				}
 				case 0x2:
 				{
@@ -471,14 +550,14 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					// put A at address in rp (only BC or DE)
 					// other register pair indices correspond to the SHLD and STA operations
 					writeMem(state, combine8(*dRegLo(state, rp, false), *dRegHi(state, rp, false)), state->regs[REG_A]);
-					return 7;
+					return opCycles[op];
 				}
 				case 0x3:
 				{
 					// INX rp
 					// increment rp, doesn't affect flags
 					if (++(*dRegLo(state, rp, false)) == 0) (*dRegHi(state, rp, false))++;
-					return 5;
+					return opCycles[op];
 				}
 				case 0x9:
 				{
@@ -490,7 +569,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					ans &= (1<<16)-1; // mod
 					state->regs[REG_L] = ans & 0xFF;
 					state->regs[REG_H] = ans>>8 & 0xFF;
-					return 10;
+					return opCycles[op];
 				}
 				case 0xA:
 				{
@@ -498,8 +577,8 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					// loads A with contents at address stored in RP
 					// rp can only be BC or DE, codes for other register pairs correspond to other instructions LHLD and
 					// LDA, which have already been covered
-					state->regs[REG_A] = state->memory[combine8(*dRegLo(state, rp, false), *dRegHi(state, rp, false))];
-					return 7;
+					state->regs[REG_A] = readMem(state, combine8(*dRegLo(state, rp, false), *dRegHi(state, rp, false)));
+					return opCycles[op];
 				}
 				case 0xB:
 				{
@@ -507,7 +586,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					// decrement rp
 					// no flags affected
 					if (--(*dRegLo(state, rp, false)) == 0xFF) --(*dRegHi(state, rp, false));
-					return 5;
+					return opCycles[op];
 				}
 			}
 			break;
@@ -524,7 +603,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 						state->psw = state->psw & ~0x28; // turn off bits 5 and 3
 						state->psw = state->psw | 2; // turn on bit 1 
 					}
-					return 10;
+					return opCycles[op];
 				}
 				case 0x5:
 				{
@@ -532,7 +611,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 					// push rp onto stack
 					push8(state, *dRegHi(state, rp, true));
 					push8(state, *dRegLo(state, rp, true));
-					return 11;
+					return opCycles[op];
 				}
 			}
 			break;
@@ -544,7 +623,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 		// puts r2 in r1
 		// MOV M, M is HLT which was already covered
 		writeReg(state, reg1, readReg(state, reg2));
-		return (reg1 == REG_M || reg2 == REG_M) ? 7 : 5;
+		return opCycles[op];
 	}
 	// single register operations
 	if (f2 == 0) {
@@ -560,7 +639,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 				setFlag(state, FLAG_AC, (x & 0xF) == 0xF);
 				//setAC(state, x, ans);
 				writeReg(state, reg1, y);
-				return 5;
+				return opCycles[op];
 			}
 			case 0x5:
 			{
@@ -573,7 +652,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 				setFlag(state, FLAG_AC, (x & 0xF) == 0);
 				setNonCarryFlags(state, y);
 				writeReg(state, reg1, y);
-				return 5;
+				return opCycles[op];
 			}
 			case 0x6:
 			{
@@ -581,7 +660,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 				// puts 8-bit data in reg1
 				writeReg(state, reg1, d1);
 				state->pc++;
-				return 7;
+				return opCycles[op];
 			}
 		}
 	}
@@ -594,7 +673,7 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 		push16(state, state->pc); 
 
 		state->pc = 8*reg1;
-		return 11;
+		return opCycles[op];
 	}
 	// CC (conditional) instructions
 	if (f2 == 3) {
@@ -603,20 +682,22 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			{
 				// Rcc
 				// if condition is true return
-				int shika = 5;
 				if (evaluateCC(state, reg1)) {
 					state->pc = pop16(state);
-					shika = 11; 
+					return opCyclesTaken[op];
 				}
-				return shika;
+				return opCycles[op];
 			}
 			case 2:
 			{
 				// Jcc ADD
 				// reg1(cc) corresponds to a specific condition, if that condition is true then jump to 16-bit add
 				state->pc += 2;
-				if (evaluateCC(state, reg1)) state->pc = combine8(d1, d2);
-				return 10;
+				if (evaluateCC(state, reg1)) {
+					state->pc = combine8(d1, d2);
+					if (__builtin_expect(state->idleSkip, 0) && state->pc < oldpc) noteBackwardJump(state, oldpc);
+				}
+				return opCycles[op];
 			}
 			case 4:
 			{
@@ -626,8 +707,9 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 				if (evaluateCC(state, reg1)) {
 					push16(state, state->pc);
 					state->pc = combine8(d1, d2);
+					return opCyclesTaken[op];
 				}
-				return 11;
+				return opCycles[op];
 			}
 		}
 	}
@@ -638,42 +720,42 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			case 0:
 			{
 				writeReg(state, REG_A, ALUadd(state, readReg(state, REG_A), readReg(state, reg2), 0));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 1:
 			{
 				writeReg(state, REG_A, ALUadd(state, readReg(state, REG_A), readReg(state, reg2), getFlag(state, FLAG_C)));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 2:
 			{
 				writeReg(state, REG_A, ALUsub(state, readReg(state, REG_A), readReg(state, reg2), 0));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 3:
 			{
 				writeReg(state, REG_A, ALUsub(state, readReg(state, REG_A), readReg(state, reg2), getFlag(state, FLAG_C)));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 4:
 			{
 				writeReg(state, REG_A, ALUand(state, readReg(state, REG_A), readReg(state, reg2), true));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 5:
 			{
 				writeReg(state, REG_A, ALUxor(state, readReg(state, REG_A), readReg(state, reg2)));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 6:
 			{
 				writeReg(state, REG_A, ALUor(state, readReg(state, REG_A), readReg(state, reg2)));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 			case 7:
 			{
 				ALUcmp(state, readReg(state, REG_A), readReg(state, reg2));
-				return (reg2 == REG_M ? 7 : 4);
+				return opCycles[op];
 			}
 		}
 	}
@@ -684,42 +766,42 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 			case 0:
 			{
 				writeReg(state, REG_A, ALUadd(state, readReg(state, REG_A), d1, 0));
-				return 7;
+				return opCycles[op];
 			}
 			case 1:
 			{
 				writeReg(state, REG_A, ALUadd(state, readReg(state, REG_A), d1, getFlag(state, FLAG_C)));
-				return 7;
+				return opCycles[op];
 			}
 			case 2:
 			{
 				writeReg(state, REG_A, ALUsub(state, readReg(state, REG_A), d1, 0));
-				return 7;
+				return opCycles[op];
 			}
 			case 3:
 			{
 				writeReg(state, REG_A, ALUsub(state, readReg(state, REG_A), d1, getFlag(state, FLAG_C)));
-				return 7;
+				return opCycles[op];
 			}
 			case 4:
 			{
 				writeReg(state, REG_A, ALUand(state, readReg(state, REG_A), d1, false));
-				return 7;
+				return opCycles[op];
 			}
 			case 5:
 			{
 				writeReg(state, REG_A, ALUxor(state, readReg(state, REG_A), d1));
-				return 7;
+				return opCycles[op];
 			}
 			case 6:
 			{
 				writeReg(state, REG_A, ALUor(state, readReg(state, REG_A), d1));
-				return 7;
+				return opCycles[op];
 			}
 			case 7:
 			{
 				ALUcmp(state, readReg(state, REG_A), d1);
-				return 7;
+				return opCycles[op];
 			}
 		}
 	}
@@ -728,26 +810,98 @@ int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
 	return 0;
 }
 
+int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2) {
+	return execOp8080(state, machine, op, d1, d2);
+}
+
+// threaded code for engines that decode ahead: one handler per opcode with the opcode folded in,
+// and one per fused sequence in fused.h (written by fusegen from a profile)
+// pc is where the (first) instruction starts, none of them look at interrupts
+static inline __attribute__((always_inline)) int stepOp8080(State8080* state, Machine* machine, u8 op, u16 pc) {
+	state->pc = pc + 1;
+	return execOp8080(state, machine, op, fetchMem(state, pc + 1), fetchMem(state, pc + 2));
+}
+
+#define OP_HANDLER(op) static int opHandler##op(State8080* state, Machine* machine, u16 pc) { \
+	return stepOp8080(state, machine, op, pc); \
+}
+#define OP_HANDLERS16(hi) OP_HANDLER(hi##0) OP_HANDLER(hi##1) OP_HANDLER(hi##2) OP_HANDLER(hi##3) \
+	OP_HANDLER(hi##4) OP_HANDLER(hi##5) OP_HANDLER(hi##6) OP_HANDLER(hi##7) \
+	OP_HANDLER(hi##8) OP_HANDLER(hi##9) OP_HANDLER(hi##A) OP_HANDLER(hi##B) \
+	OP_HANDLER(hi##C) OP_HANDLER(hi##D) OP_HANDLER(hi##E) OP_HANDLER(hi##F)
+OP_HANDLERS16(0x0) OP_HANDLERS16(0x1) OP_HANDLERS16(0x2) OP_HANDLERS16(0x3)
+OP_HANDLERS16(0x4) OP_HANDLERS16(0x5) OP_HANDLERS16(0x6) OP_HANDLERS16(0x7)
+OP_HANDLERS16(0x8) OP_HANDLERS16(0x9) OP_HANDLERS16(0xA) OP_HANDLERS16(0xB)
+OP_HANDLERS16(0xC) OP_HANDLERS16(0xD) OP_HANDLERS16(0xE) OP_HANDLERS16(0xF)
+
+#define OP_ENTRIES16(hi) opHandler##hi##0, opHandler##hi##1, opHandler##hi##2, opHandler##hi##3, \
+	opHandler##hi##4, opHandler##hi##5, opHandler##hi##6, opHandler##hi##7, \
+	opHandler##hi##8, opHandler##hi##9, opHandler##hi##A, opHandler##hi##B, \
+	opHandler##hi##C, opHandler##hi##D, opHandler##hi##E, opHandler##hi##F,
+const OpHandler opHandlers8080[256] = {
+	OP_ENTRIES16(0x0) OP_ENTRIES16(0x1) OP_ENTRIES16(0x2) OP_ENTRIES16(0x3)
+	OP_ENTRIES16(0x4) OP_ENTRIES16(0x5) OP_ENTRIES16(0x6) OP_ENTRIES16(0x7)
+	OP_ENTRIES16(0x8) OP_ENTRIES16(0x9) OP_ENTRIES16(0xA) OP_ENTRIES16(0xB)
+	OP_ENTRIES16(0xC) OP_ENTRIES16(0xD) OP_ENTRIES16(0xE) OP_ENTRIES16(0xF)
+};
+
+// only the last instruction of a sequence may jump, so the others are always 1 after another
+#define FUSE2(a, b) static int fused##a##b(State8080* state, Machine* machine, u16 pc) { \
+	int cycles = stepOp8080(state, machine, a, pc); \
+	return cycles + stepOp8080(state, machine, b, pc + opSize8080(a)); \
+}
+#define FUSE3(a, b, c) static int fused##a##b##c(State8080* state, Machine* machine, u16 pc) { \
+	int cycles = stepOp8080(state, machine, a, pc); \
+	cycles += stepOp8080(state, machine, b, pc + opSize8080(a)); \
+	return cycles + stepOp8080(state, machine, c, pc + opSize8080(a) + opSize8080(b)); \
+}
+#include "fused.h"
+#undef FUSE2
+#undef FUSE3
+
+#define FUSE2(a, b) {2, {a, b}, fused##a##b},
+#define FUSE3(a, b, c) {3, {a, b, c}, fused##a##b##c},
+const FusedOp fusedOps8080[] = {
+#include "fused.h"
+	{0}
+};
+#undef FUSE2
+#undef FUSE3
+const int numFusedOps8080 = sizeof(fusedOps8080) / sizeof(fusedOps8080[0]) - 1;
+
 int nextOp8080(State8080* state, Machine* machine) {
 	u8 op, d1, d2;
 	op = d1 = d2 = 0;
 	u16 oldpc = state->pc;
 	bool wasinterrupted = false;
-	if (!state->interrupted || !state->interruptsEnabled) {
+	if (__builtin_expect(state->interrupted, 0)) {
+		if (state->eiDelay) {
+			// the instruction after EI runs before anything pending is taken
+			state->eiDelay = false;
+			state->interrupted = state->interruptPending;
+		}
+		else wasinterrupted = true;
+	}
+	if (!wasinterrupted) {
 		if (state->halted) return 1;
-		op = state->memory[state->pc];
+		op = fetchMem(state, state->pc);
 		// d1 and d2 are data
-		d1 = state->memory[state->pc + 1];
-		d2 = state->memory[state->pc + 2];
+		d1 = fetchMem(state, state->pc + 1);
+		d2 = fetchMem(state, state->pc + 2);
 		if (DISASSEMBLE) {
 			opsizes[oldpc] = disassemble8080(disassembledProgram[oldpc], op, d1, d2, oldpc);
 		}
+		if (state->executed != NULL) state->executed[oldpc >> 3] |= 1 << (oldpc & 7);
 		state->pc++;
 	}
 	else {
 		state->interruptsEnabled = false;
+		state->interruptPending = false;
+		state->interrupted = false;
 		state->halted = false;
-		wasinterrupted = true;
+		// the handler can change what an idle loop is waiting on
+		state->idleArmed = false;
+		state->idleCycles = 0;
 		op = state->interruptbus[0];
 		d1 = state->interruptbus[1];
 		d2 = state->interruptbus[2];
@@ -757,18 +911,17 @@ int nextOp8080(State8080* state, Machine* machine) {
 		fprintf(pclogFile, "%d\t", wasinterrupted);
 		fprintf(pclogFile, "%04X", oldpc);
 		fprintf(pclogFile, "\t%02X", state->psw);
-		fprintf(pclogFile, "\t%02X %02X", state->memory[state->sp], state->memory[state->sp+1]);
+		fprintf(pclogFile, "\t%02X %02X", readMem(state, state->sp), readMem(state, state->sp+1));
 		fprintf(pclogFile, "\n");
 	}
 
 	int ans = emulateOp8080(state, machine, op, d1, d2);
+	// Jcc, Ccc and Rcc, taken if they went anywhere but the next instruction
+	if (state->branches != NULL && !wasinterrupted && ((op & 0xC7) == 0xC0 || (op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4)) {
+		bool taken = state->pc != (u16)(oldpc + opSize8080(op));
+		state->branches[oldpc >> 2] |= 1 << ((oldpc & 3) * 2 + !taken);
+	}
 	//if (ans == 10000) printf("bad instruction at %X\n", oldpc);
-	// clear interruptbus since interrupts should not
-	// be queued
-	state->interruptbus[0] = 0;
-	state->interruptbus[1] = 0;
-	state->interruptbus[2] = 0;
-	state->interrupted = false;
 	return ans;
 }
 
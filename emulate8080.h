@@ -3,13 +3,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
 #define MEM_SZ (1<<16)
+// what's allocated for memory, MEM_SZ+2 in whole pages
+#define MEM_ALIGN 4096
+#define MEM_ALLOC_SZ (MEM_SZ + MEM_ALIGN)
 #define CLOCK_SPEED 2000000
 
 #define DEBUG false 
 #define DISASSEMBLE false
-#define SPACE_INVADERS_MEM_SAFETY false
+
+// memory is accessed through a page table of 256 byte pages
+#define PAGE_SHIFT 8
+#define PAGE_SZ (1<<PAGE_SHIFT)
+#define NUM_PAGES (MEM_SZ>>PAGE_SHIFT)
+
+// longest loop body (in bytes) considered for idle skipping
+#define MAX_IDLE_LOOP 32
 
 typedef uint8_t u8;
 typedef uint16_t u16;
@@ -20,28 +32,192 @@ enum Flag {
 enum Reg {
 	REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_M, REG_A
 };
+enum PageFlag {
+	PAGE_ROM=1, // writes are dropped
+	PAGE_TRAP_R=2, // reads call state->memTrap
+	PAGE_TRAP_W=4, // writes call state->memTrap (before the write lands)
+	PAGE_HASH=8 // writes keep state->ramHash up to date (see enableRamHash8080)
+};
+
+struct State8080;
+typedef void (*MemTrap)(struct State8080* state, u16 addr, u8 val, bool write);
+
+// the state an instruction touches (besides memory and the page tables) comes first, packed
+// into one cache line, the rest is only looked at on the slow paths
 typedef struct State8080 {
-	u8 regs[8]; // B, C, D, E, H, L, M, A
+	_Alignas(64) u8 regs[8]; // B, C, D, E, H, L, M, A
 	u8 psw; // status register
-	u16 pc;
-	u16 sp;
-	volatile u8 interruptbus[3]; // op, optional data1 and data2
-	bool interrupted;
+	bool interrupted; // take it (or finish an EI) before the next instruction, all the hot path looks at
 	bool halted;
-	u8 memory[MEM_SZ+2];
 	bool interruptsEnabled;
+	u16 pc;
+	u16 sp;
+	bool idleSkip; // idle loop skipping (see waitForInterrupt8080), off unless set
+	bool idleArmed;
+	u16 idleHead; // loop head and the backward jump to it
+	u16 idleFrom;
+	u16 idleCycles; // set (to the cycles per trip) while at the head of a verified idle loop
+	u8* memory; // MEM_SZ+2 bytes, page aligned and allocated apart from the state
+	// coverage (see coverage.h), only nextOp8080 fills these in
+	u8* executed; // NULL, or a bit per address set when an instruction starts there
+	u8* branches; // NULL, or two bits per address, conditional taken then not taken
+
+	// the interrupt line: a raised interrupt stays pending until it's taken, which is when
+	// interrupts are enabled and the instruction after the EI that enabled them has run
+	_Alignas(64) u8 interruptbus[3]; // what the pending interrupt puts on the bus, op, optional data1 and data2
+	bool interruptPending;
+	bool eiDelay; // the last instruction was EI
+	_Atomic u8 interruptRequest; // an RST raised from another thread, 0 for none (see requestInterrupt8080)
 	volatile bool on;
+
+	u8 idleRegs[8]; // registers on the last trip to idleHead
+	u8 idlePsw;
+	u16 idleSp;
+
+	const void* engineData; // whatever attach set up for the engine running this state
+
+	// while ramHashed, the XOR of ramByteHash over every byte of writable memory, kept up to
+	// date a write at a time (writes to those pages take the slow path)
+	bool ramHashed;
+	uint64_t ramHash;
+
+	// page table
+	// rpage/wpage are what every access indexes, a NULL entry sends it down the slow path
+	// (trapped pages), rbase/wbase are where each page really lives
+	const u8* rpage[NUM_PAGES];
+	u8* wpage[NUM_PAGES];
+	const u8* rbase[NUM_PAGES];
+	u8* wbase[NUM_PAGES];
+	u8 pageFlags[NUM_PAGES];
+	MemTrap memTrap;
+	void* trapData;
+	u8 sinkPage[PAGE_SZ]; // where writes to ROM go
 } State8080;
 
+_Static_assert(offsetof(State8080, interruptbus) == 64, "State8080's hot fields should fit one cache line");
+
 #include "machine.h"
 
+// the state and its memory are two allocations, freeState8080 releases both
 State8080* initState8080();
-static inline void writeMem(State8080* state, u16 addr, u8 val);
+void freeState8080(State8080* state);
+// power on state in place, for states allocated some other way (see pool.h)
+// memory is MEM_ALLOC_SZ bytes, MEM_ALIGN aligned
+void setupState8080(State8080* state, u8* memory);
+
+// [start, end) must be page aligned
+// write == NULL maps the range read-only
+void mapMemory8080(State8080* state, int start, int end, const u8* read, u8* write);
+// makes [start, end) an alias of the same sized range at src
+void mirrorMemory8080(State8080* state, int start, int end, int src);
+void setPageFlags8080(State8080* state, int start, int end, u8 flags);
+void clearPageFlags8080(State8080* state, int start, int end, u8 flags);
+
+// one byte of memory's share of ramHash, offset from state->memory so mirrors agree
+static inline uint64_t ramByteHash(uint32_t offset, u8 val) {
+	uint64_t x = ((uint64_t)offset << 8 | val) * 0x9E3779B97F4A7C15ull;
+	x ^= x >> 29;
+	x *= 0xBF58476D1CE4E5B9ull;
+	return x ^ x >> 32;
+}
+// hashes everything writable in state->memory (the pages snapshot.h keeps) and keeps
+// it hashed until disableRamHash8080, for map changes call it again
+void enableRamHash8080(State8080* state);
+void disableRamHash8080(State8080* state);
+// from scratch, for after memory was written behind writeMem's back
+uint64_t computeRamHash8080(const State8080* state);
+
+u8 readMemSlow(State8080* state, u16 addr);
+void writeMemSlow(State8080* state, u16 addr, u8 val);
+
+static inline u8 readMem(State8080* state, u16 addr) {
+	const u8* page = state->rpage[addr >> PAGE_SHIFT];
+	if (__builtin_expect(page != NULL, 1)) return page[addr & (PAGE_SZ-1)];
+	return readMemSlow(state, addr);
+}
+// instruction fetches skip the traps (a read watchpoint shouldn't fire on operand bytes
+// that just happen to follow an opcode)
+static inline u8 fetchMem(State8080* state, u16 addr) {
+	return state->rbase[addr >> PAGE_SHIFT][addr & (PAGE_SZ-1)];
+}
+static inline void writeMem(State8080* state, u16 addr, u8 val) {
+	u8* page = state->wpage[addr >> PAGE_SHIFT];
+	if (__builtin_expect(page != NULL, 1)) page[addr & (PAGE_SZ-1)] = val;
+	else writeMemSlow(state, addr, val);
+}
+
+// raises the interrupt line, from the thread running the cpu
+// a second interrupt before the first is taken replaces it, like a new RST on the bus would
 void generateInterrupt(State8080* state, u8 opcode, u8 data1, u8 data2);
+// the same from any other thread, it's raised the next time the cpu thread calls takeInterruptRequest8080
+// (runUntil does between runs)
+static inline void requestInterrupt8080(State8080* state, u8 rst) {
+	atomic_store_explicit(&state->interruptRequest, rst, memory_order_release);
+}
+static inline void takeInterruptRequest8080(State8080* state) {
+	if (__builtin_expect(atomic_load_explicit(&state->interruptRequest, memory_order_relaxed) == 0, 1)) return;
+	u8 rst = atomic_exchange_explicit(&state->interruptRequest, 0, memory_order_acquire);
+	if (rst != 0) generateInterrupt(state, rst, 0, 0);
+}
+
+// EI and DI, shared with the generated code
+// EI always sends the next instruction down the slow path, which runs it before anything pending
+static inline void enableInterrupts8080(State8080* state) {
+	state->interruptsEnabled = true;
+	state->eiDelay = true;
+	state->interrupted = true;
+}
+static inline void disableInterrupts8080(State8080* state) {
+	state->interruptsEnabled = false;
+	state->eiDelay = false;
+	state->interrupted = false;
+}
 int emulateOp8080(State8080* state, Machine* machine, u8 op, u8 d1, u8 d2);
 int nextOp8080(State8080* state, Machine* machine);
+
+// instruction length in bytes (including the undocumented aliases)
+static inline int opSize8080(u8 op) {
+	// LXI, SHLD, LHLD, STA, LDA
+	if ((op & 0xCF) == 0x01 || (op & 0xE7) == 0x22) return 3;
+	// JMP, Jcc, CALL, Ccc and their aliases
+	if (op == 0xC3 || op == 0xCB || (op & 0xC7) == 0xC2 || (op & 0xC7) == 0xC4 || (op & 0xCF) == 0xCD) return 3;
+	// MVI, ALU immediate, IN, OUT
+	if ((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6 || op == 0xD3 || op == 0xDB) return 2;
+	return 1;
+}
+
+// runs the instruction starting at pc (from ROM, decoded ahead of time), returns the cycles taken
+typedef int (*OpHandler)(State8080* state, Machine* machine, u16 pc);
+extern const OpHandler opHandlers8080[256];
+
+// a run of 2 or 3 instructions executed by one handler, only the last may jump or halt
+typedef struct FusedOp {
+	int len;
+	u8 ops[3];
+	OpHandler handler;
+} FusedOp;
+extern const FusedOp fusedOps8080[];
+extern const int numFusedOps8080;
 void run8080(State8080* state, Machine* machine);
 
+extern const int CYCLES_PER_BLOCK;
+
+// per-opcode cycle counts, opCyclesTaken has the longer Rcc/Ccc timings for when the condition holds
+extern const u8 opCycles[256];
+extern const u8 opCyclesTaken[256];
+
+// call after each instruction when running up to a deadline (the next interrupt)
+// a halted cpu can't do anything before then, and one in a verified idle loop would just go
+// round it, so move the clock forward over as many whole trips as fit before deadline
+static inline void waitForInterrupt8080(State8080* state, int64_t* clock, int64_t deadline) {
+	if (__builtin_expect(!state->halted && state->idleCycles == 0, 1)) return;
+	if (state->halted) *clock = deadline;
+	else {
+		*clock += (deadline - *clock) / state->idleCycles * state->idleCycles;
+		state->idleCycles = 0;
+	}
+}
+
 void initPcLogFile();
 void initDisassembleFile();
 void cleanPcLogFile();
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "engine.h"
+#include "emulate8080.h"
+#include "machine.h"
+#include "aot.h"
+#include "fuse.h"
+#include "rom.h"
+
+static int runInterp(State8080* state, Machine* machine, int budget) {
+	int used = 0;
+	do used += nextOp8080(state, machine);
+	while (used < budget && !state->halted && state->idleCycles == 0);
+	return used;
+}
+
+static bool attachIdle(State8080* state) {
+	state->idleSkip = true;
+	return true;
+}
+
+// the translation is only any good for the ROM it was made from
+static bool attachAot(State8080* state) {
+	u8 image[ROM_SZ];
+	for (int i = 0; i < ROM_SZ; i++) image[i] = fetchMem(state, i);
+	uint32_t crc = romCrc32(image, ROM_SZ);
+	if (crc != aotRomCrc) {
+		printf("aot was generated from a ROM with CRC32 %08x, this one is %08x\n", aotRomCrc, crc);
+		return false;
+	}
+	return true;
+}
+
+const Engine engines[] = {
+	{"interp", runInterp, NULL},
+	{"idle", runInterp, attachIdle},
+	{"aot", aotRun, attachAot},
+	{"fused", runFused, attachFused},
+};
+const int numEngines = sizeof(engines) / sizeof(engines[0]);
+
+const Engine* findEngine(const char* name) {
+	for (int i = 0; i < numEngines; i++) {
+		if (!strcmp(engines[i].name, name)) return &engines[i];
+	}
+	printf("No engine called %s, have:", name);
+	for (int i = 0; i < numEngines; i++) printf(" %s", engines[i].name);
+	printf("\n");
+	return NULL;
+}
+
+bool attachEngine(const Engine* engine, State8080* state) {
+	return engine->attach == NULL || engine->attach(state);
+}
+
+void runUntil(const Engine* engine, State8080* state, Machine* mach, int64_t* clock, int64_t deadline) {
+	while (*clock < deadline) {
+		takeInterruptRequest8080(state);
+		*clock += engine->run(state, mach, deadline - *clock);
+		waitForInterrupt8080(state, clock, deadline);
+	}
+}
+
+void runFrame(const Engine* engine, State8080* state, Machine* mach, int64_t* clock) {
+	int64_t frameStart = *clock - *clock % CYCLES_PER_FRAME;
+	runUntil(engine, state, mach, clock, frameStart + CYCLES_PER_HALF_FRAME);
+	VBlankHalfInterrupt(mach, state);
+	runUntil(engine, state, mach, clock, frameStart + CYCLES_PER_FRAME);
+	VBlankFullInterrupt(mach, state);
+}
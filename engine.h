@@ -0,0 +1,39 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// a way of executing 8080 code
+// run executes at least one instruction and keeps going while it has used fewer than budget
+// cycles, stopping early if the cpu halts or finds an idle loop, and returns the cycles used
+// (so it stops on exactly the same instruction the interpreter would)
+// attach (may be NULL) sets up anything the engine needs on a fresh state, false if it can't run it
+typedef struct Engine {
+	const char* name;
+	int (*run)(State8080* state, Machine* machine, int budget);
+	bool (*attach)(State8080* state);
+} Engine;
+
+// the first entry is the reference interpreter everything else gets checked against
+extern const Engine engines[];
+extern const int numEngines;
+
+// NULL (after listing what there is) if there's no engine called name
+const Engine* findEngine(const char* name);
+
+// false (after printing why) if the engine can't run this state
+bool attachEngine(const Engine* engine, State8080* state);
+
+// runs until clock reaches deadline (the next scheduled interrupt)
+// a halted or idling cpu skips ahead instead of spinning (waitForInterrupt8080)
+void runUntil(const Engine* engine, State8080* state, Machine* mach, int64_t* clock, int64_t deadline);
+
+// runs one frame headless: up to the mid-screen interrupt, then up to vblank
+// clock is the running cycle count, overshoot past a deadline is taken out of the next slice
+void runFrame(const Engine* engine, State8080* state, Machine* mach, int64_t* clock);
+
+#endif
@@ -0,0 +1,248 @@
+// frame hash regression suite: replays every movie in a directory headless, hashing VRAM (XXH64)
+// at the end of each frame, and checks the hashes against the committed <movie>.hash next to it
+// movies run in parallel, one per core
+// on a mismatch the reference interpreter is replayed to the same frame and both screens are
+// written out as <movie>-<frame>-expected.ppm and <movie>-<frame>-actual.ppm
+//
+// usage: ./framecheck [-e engine] [-j threads] [-u] [dir]
+//   -u  (re)write the golden files instead of checking them, only from the reference interpreter
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "movie.h"
+#include "capture.h"
+#include "hash.h"
+#include "rom.h"
+#include "platform.h"
+
+#define MAX_MOVIES 256
+#define PATH_SZ 1024
+
+enum Result {
+	RESULT_PASS, RESULT_FAIL, RESULT_NEW, RESULT_ERROR
+};
+
+typedef struct Job {
+	char name[PATH_SZ]; // without .mov
+	enum Result result;
+	int frames;
+	int badFrame;
+	int64_t nanos;
+	const char* why; // for an error, NULL if it was already printed
+} Job;
+
+static const char* dir = "golden";
+static const Engine* engine;
+static const u8* rom;
+static bool update = false;
+static Job jobs[MAX_MOVIES];
+static int numJobs = 0;
+static atomic_int nextJob;
+
+static uint64_t hashVram(State8080* state) {
+	return xxh64(state->memory + VRAM_START, VRAM_SZ, 0);
+}
+
+// NULL if there's no golden file yet, frames is set to how many hashes it has
+static uint64_t* loadHashes(const char* path, int* frames) {
+	FILE* f = fopen(path, "r");
+	if (f == NULL) return NULL;
+	int cap = 1024;
+	uint64_t* hashes = malloc(cap * sizeof(uint64_t));
+	*frames = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (line[0] == '#' || line[0] == '\n') continue;
+		if (*frames == cap) {
+			cap *= 2;
+			hashes = realloc(hashes, cap * sizeof(uint64_t));
+		}
+		hashes[(*frames)++] = strtoull(line, NULL, 16);
+	}
+	fclose(f);
+	return hashes;
+}
+
+static bool saveHashes(const char* path, const char* movie, uint64_t* hashes, int frames) {
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		printf("Could not write %s\n", path);
+		return false;
+	}
+	fprintf(f, "# xxh64 of VRAM at the end of each frame of %s.mov, written by ./framecheck -u\n", movie);
+	for (int i = 0; i < frames; i++) fprintf(f, "%016llx\n", (unsigned long long)hashes[i]);
+	fclose(f);
+	return true;
+}
+
+// plays movie on engine, stopping after frame stop (or at the end) with the state left there
+// hashes (if not NULL) gets one per frame, stops early at the first that differs from expect
+// returns the number of frames run
+static int replay(const Engine* eng, Movie* movie, State8080* state, Machine* machine,
+		uint64_t* hashes, const uint64_t* expect, int expectFrames, int stop) {
+	machineMapMemory(machine, state, rom);
+	if (!attachEngine(eng, state)) return -1;
+	int64_t clock = 0;
+	for (int f = 0; f < movie->frames && f <= stop; f++) {
+		playFrame(movie, machine, f);
+		runFrame(eng, state, machine, &clock);
+		if (hashes == NULL) continue;
+		hashes[f] = hashVram(state);
+		if (expect != NULL && (f >= expectFrames || hashes[f] != expect[f])) return f + 1;
+	}
+	return stop < movie->frames ? stop + 1 : movie->frames;
+}
+
+// the screens behind a mismatch, the expected one from the reference interpreter
+static void dumpMismatch(Job* job, Movie* movie, State8080* actual) {
+	char path[PATH_SZ + 64];
+	const char* base = strrchr(job->name, '/') != NULL ? strrchr(job->name, '/') + 1 : job->name;
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+	replay(&engines[0], movie, state, machine, NULL, NULL, 0, job->badFrame);
+	snprintf(path, sizeof(path), "%s-%d-expected.ppm", base, job->badFrame);
+	saveVramPpm(path, state->memory + VRAM_START, 2);
+	snprintf(path, sizeof(path), "%s-%d-actual.ppm", base, job->badFrame);
+	saveVramPpm(path, actual->memory + VRAM_START, 2);
+	freeState8080(state);
+	free(machine);
+}
+
+static void runJob(Job* job) {
+	char path[PATH_SZ + 8];
+	snprintf(path, sizeof(path), "%s.mov", job->name);
+	Movie* movie = loadMovie(path);
+	if (movie == NULL) {
+		job->result = RESULT_ERROR;
+		return;
+	}
+	job->frames = movie->frames;
+	snprintf(path, sizeof(path), "%s.hash", job->name);
+	int expectFrames = 0;
+	uint64_t* expect = update ? NULL : loadHashes(path, &expectFrames);
+	uint64_t* hashes = malloc((movie->frames + 1) * sizeof(uint64_t));
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+
+	int64_t start = currNano();
+	int ran = replay(engine, movie, state, machine, hashes, expect, expectFrames, movie->frames);
+	job->nanos = currNano() - start;
+	if (ran < 0) job->result = RESULT_ERROR;
+	else if (update) {
+		job->result = saveHashes(path, strrchr(job->name, '/') + 1, hashes, movie->frames) ? RESULT_NEW : RESULT_ERROR;
+	}
+	else if (expect == NULL) {
+		job->result = RESULT_ERROR;
+		job->why = "no golden, run -u";
+	}
+	else if (ran < movie->frames || expectFrames != movie->frames) {
+		job->result = RESULT_FAIL;
+		job->badFrame = ran - 1;
+		if (ran == movie->frames && expectFrames > movie->frames) job->badFrame = movie->frames;
+		else dumpMismatch(job, movie, state);
+	}
+	else job->result = RESULT_PASS;
+
+	freeState8080(state);
+	free(machine);
+	free(hashes);
+	free(expect);
+	freeMovie(movie);
+}
+
+static void* worker(void* arg) {
+	(void)arg;
+	int i;
+	while ((i = atomic_fetch_add(&nextJob, 1)) < numJobs) runJob(&jobs[i]);
+	return NULL;
+}
+
+static int byName(const void* a, const void* b) {
+	return strcmp(((const Job*)a)->name, ((const Job*)b)->name);
+}
+
+static bool findMovies() {
+	DIR* d = opendir(dir);
+	if (d == NULL) {
+		printf("Could not open %s\n", dir);
+		return false;
+	}
+	struct dirent* e;
+	while ((e = readdir(d)) != NULL && numJobs < MAX_MOVIES) {
+		int len = strlen(e->d_name);
+		if (len < 5 || strcmp(e->d_name + len - 4, ".mov")) continue;
+		snprintf(jobs[numJobs].name, PATH_SZ, "%s/%.*s", dir, len - 4, e->d_name);
+		numJobs++;
+	}
+	closedir(d);
+	qsort(jobs, numJobs, sizeof(Job), byName);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* engineName = "interp";
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-e") && i + 1 < argc) engineName = argv[++i];
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-u")) update = true;
+		else if (argv[i][0] != '-') dir = argv[i];
+		else {
+			printf("usage: %s [-e engine] [-j threads] [-u] [dir]\n", argv[0]);
+			return 1;
+		}
+	}
+	engine = findEngine(engineName);
+	if (engine == NULL) return 1;
+	// the goldens are what the reference interpreter draws, everything else is checked against them
+	if (update && engine != &engines[0]) {
+		printf("-u only writes goldens from %s, not %s\n", engines[0].name, engine->name);
+		return 1;
+	}
+	rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	if (!findMovies()) return 1;
+	if (threads < 1) threads = 1;
+	if (threads > numJobs) threads = numJobs;
+
+	int64_t start = currNano();
+	atomic_init(&nextJob, 0);
+	pthread_t* pool = malloc(threads * sizeof(pthread_t));
+	for (int i = 0; i < threads; i++) pthread_create(&pool[i], NULL, worker, NULL);
+	for (int i = 0; i < threads; i++) pthread_join(pool[i], NULL);
+	free(pool);
+
+	int failures = 0;
+	for (int i = 0; i < numJobs; i++) {
+		Job* job = &jobs[i];
+		switch (job->result) {
+			case RESULT_PASS:
+				printf("PASS  %-30s %6d frames %8.2f s\n", job->name, job->frames, job->nanos / 1e9);
+				break;
+			case RESULT_NEW:
+				printf("WROTE %-30s %6d frames %8.2f s\n", job->name, job->frames, job->nanos / 1e9);
+				break;
+			case RESULT_FAIL:
+				printf("FAIL  %-30s first mismatch at frame %d\n", job->name, job->badFrame);
+				failures++;
+				break;
+			case RESULT_ERROR:
+				if (job->why != NULL) printf("ERROR %-30s %s\n", job->name, job->why);
+				else printf("ERROR %-30s\n", job->name);
+				failures++;
+				break;
+		}
+	}
+	printf("%d movies on %s, %d failed, %.2f s with %d threads\n",
+			numJobs, engine->name, failures, (currNano() - start) / 1e9, threads);
+	return failures == 0 ? 0 : 1;
+}
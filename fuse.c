@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "fuse.h"
+#include "emulate8080.h"
+#include "machine.h"
+#include "cfg.h"
+#include "rom.h"
+
+#define MAX_DECODED 4
+
+typedef struct FuseSlot {
+	OpHandler handler;
+	int guard; // cycles before the last instruction, the budget has to have more than this left
+} FuseSlot;
+
+typedef struct Decoded {
+	uint32_t crc;
+	FuseSlot slots[ROM_SZ];
+} Decoded;
+
+static pthread_mutex_t decodeLock = PTHREAD_MUTEX_INITIALIZER;
+static Decoded* decoded[MAX_DECODED];
+static int numDecoded = 0;
+
+// does the fused sequence match the code at pc
+static bool matches(const u8* image, int pc, const FusedOp* f) {
+	for (int i = 0; i < f->len; i++) {
+		if (pc >= ROM_SZ || image[pc] != f->ops[i]) return false;
+		// everything but the last has to fall through to the next, and EI has to be last too
+		// (the instruction after it runs through nextOp8080, fusegen never fuses past it)
+		if (i < f->len - 1 && (flowKind8080(image[pc]) != FLOW_NEXT || image[pc] == 0xFB)) return false;
+		pc += opSize8080(image[pc]);
+	}
+	return pc <= ROM_SZ;
+}
+
+static void decode(Decoded* d, const u8* image) {
+	for (int pc = 0; pc < ROM_SZ; pc++) {
+		d->slots[pc].handler = opHandlers8080[image[pc]];
+		d->slots[pc].guard = 0;
+		// fusedOps8080 is hottest first, take the first that fits
+		for (int i = 0; i < numFusedOps8080; i++) {
+			const FusedOp* f = &fusedOps8080[i];
+			if (!matches(image, pc, f)) continue;
+			int guard = 0;
+			for (int j = 0, p = pc; j < f->len - 1; j++) {
+				guard += opCycles[image[p]];
+				p += opSize8080(image[p]);
+			}
+			d->slots[pc].handler = f->handler;
+			d->slots[pc].guard = guard;
+			break;
+		}
+	}
+}
+
+bool attachFused(State8080* state) {
+	u8 image[ROM_SZ];
+	for (int i = 0; i < ROM_SZ; i++) image[i] = fetchMem(state, i);
+	uint32_t crc = romCrc32(image, ROM_SZ);
+	pthread_mutex_lock(&decodeLock);
+	Decoded* d = NULL;
+	for (int i = 0; i < numDecoded; i++) {
+		if (decoded[i]->crc == crc) d = decoded[i];
+	}
+	if (d == NULL) {
+		if (numDecoded == MAX_DECODED) {
+			pthread_mutex_unlock(&decodeLock);
+			printf("Too many different ROMs for the fused engine\n");
+			return false;
+		}
+		d = malloc(sizeof(Decoded));
+		d->crc = crc;
+		decode(d, image);
+		decoded[numDecoded++] = d;
+	}
+	pthread_mutex_unlock(&decodeLock);
+	state->engineData = d;
+	return true;
+}
+
+int runFused(State8080* state, Machine* machine, int budget) {
+	const FuseSlot* slots = ((const Decoded*)state->engineData)->slots;
+	int used = 0;
+	do {
+		u16 pc = state->pc;
+		if (__builtin_expect(pc >= ROM_SZ || state->interrupted || state->halted, 0)) {
+			used += nextOp8080(state, machine);
+			continue;
+		}
+		const FuseSlot* slot = &slots[pc];
+		// a sequence that could run past the budget goes one instruction at a time
+		if (__builtin_expect(budget - used > slot->guard, 1)) used += slot->handler(state, machine, pc);
+		else used += opHandlers8080[fetchMem(state, pc)](state, machine, pc);
+	} while (used < budget && !state->halted);
+	return used;
+}
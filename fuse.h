@@ -0,0 +1,17 @@
+#ifndef FUSE_H
+#define FUSE_H
+
+#include <stdbool.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// the "fused" engine: the ROM decoded ahead of time into one handler per PC, taking the
+// sequences in fused.h as a single handler wherever they start, anything else (RAM, interrupts,
+// a halted cpu) goes through nextOp8080
+
+// decodes the ROM the state has mapped (shared between states with the same ROM)
+bool attachFused(State8080* state);
+int runFused(State8080* state, Machine* machine, int budget);
+
+#endif
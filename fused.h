@@ -0,0 +1,34 @@
+// generated by fusegen from attract mode (13673623 instructions), don't edit
+// FUSE2/FUSE3 are defined by whoever includes this, hottest first
+FUSE3(0x3A, 0x3D, 0xC2) // LDA 0000; DCR A; JNZ 0000, 32.2% of instructions
+FUSE3(0x3A, 0xA7, 0xC2) // LDA 0000; ANA A; JNZ 0000, 28.0% of instructions
+FUSE2(0xA7, 0xC2) // ANA A; JNZ 0000, 23.0% of instructions
+FUSE2(0x3A, 0xA7) // LDA 0000; ANA A, 22.6% of instructions
+FUSE2(0x3D, 0xC2) // DCR A; JNZ 0000, 21.4% of instructions
+FUSE2(0x3A, 0x3D) // LDA 0000; DCR A, 21.4% of instructions
+FUSE3(0x7E, 0xA7, 0xC2) // MOV A , M; ANA A; JNZ 0000, 6.6% of instructions
+FUSE3(0x23, 0x05, 0xC2) // INX HL; DCR B; JNZ 0000, 6.4% of instructions
+FUSE3(0x3A, 0xA7, 0xCA) // LDA 0000; ANA A; JZ 0000, 5.6% of instructions
+FUSE3(0xD3, 0x3A, 0xA7) // OUT 00; LDA 0000; ANA A, 5.3% of instructions
+FUSE2(0x05, 0xC2) // DCR B; JNZ 0000, 5.6% of instructions
+FUSE2(0x7E, 0xA7) // MOV A , M; ANA A, 4.5% of instructions
+FUSE2(0x23, 0x05) // INX HL; DCR B, 4.3% of instructions
+FUSE2(0xA7, 0xCA) // ANA A; JZ 0000, 3.7% of instructions
+FUSE2(0xD3, 0x3A) // OUT 00; LDA 0000, 3.6% of instructions
+FUSE3(0x77, 0x23, 0x13) // MOV M , A; INX HL; INX DE, 1.4% of instructions
+FUSE3(0x3A, 0xFE, 0xC9) // LDA 0000; CPI 00; RET, 1.4% of instructions
+FUSE2(0x3A, 0xFE) // LDA 0000; CPI 00, 1.4% of instructions
+FUSE3(0x1A, 0x77, 0x23) // LDAX DE; MOV M , A; INX HL, 0.9% of instructions
+FUSE3(0x23, 0x13, 0x05) // INX HL; INX DE; DCR B, 0.9% of instructions
+FUSE3(0x13, 0x05, 0xC2) // INX DE; DCR B; JNZ 0000, 0.9% of instructions
+FUSE3(0xD3, 0xDB, 0x77) // OUT 00; IN 00; MOV M , A, 0.8% of instructions
+FUSE3(0x01, 0x09, 0xC1) // LXI BC 0000; DAD BC; POP BC, 0.8% of instructions
+FUSE3(0x09, 0xC1, 0x05) // DAD BC; POP BC; DCR B, 0.8% of instructions
+FUSE3(0xC1, 0x05, 0xC2) // POP BC; DCR B; JNZ 0000, 0.8% of instructions
+FUSE2(0x77, 0x23) // MOV M , A; INX HL, 0.9% of instructions
+FUSE2(0x23, 0x13) // INX HL; INX DE, 0.9% of instructions
+FUSE2(0xFE, 0xC9) // CPI 00; RET, 0.9% of instructions
+FUSE2(0xFE, 0xDA) // CPI 00; JC 0000, 0.9% of instructions
+FUSE3(0x36, 0x23, 0x7D) // MVI M , 00; INX HL; MOV A , L, 0.6% of instructions
+FUSE3(0x23, 0x7D, 0xE6) // INX HL; MOV A , L; ANI 00, 0.6% of instructions
+FUSE3(0x7D, 0xE6, 0xFE) // MOV A , L; ANI 00; CPI 00, 0.6% of instructions
@@ -0,0 +1,232 @@
+// picks the instruction sequences worth fusing for the "fused" engine (see fuse.h)
+// runs a recorded session (or attract mode) on the interpreter counting how often each PC
+// executes, sums that per opcode pair and triple of straight line ROM code, and writes the
+// hottest as fused.h, rebuild to pick it up
+//
+// usage: ./fusegen [-m movie] [-n frames] [-k max] [-o fused.h]
+//        ./fusegen -c [-t trials]   checks the fused handlers built into this binary against emulateOp8080
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "disassemble.h"
+#include "cfg.h"
+#include "movie.h"
+#include "rom.h"
+
+#define MAX_PATTERNS (1<<16)
+
+typedef struct Pattern {
+	int len;
+	u8 ops[3];
+	uint64_t count; // times it started executing
+} Pattern;
+
+static uint64_t pcCounts[MEM_SZ];
+
+static void profileUntil(State8080* state, Machine* machine, int64_t* clock, int64_t deadline) {
+	while (*clock < deadline) {
+		if (!state->interrupted && !state->halted) pcCounts[state->pc]++;
+		*clock += nextOp8080(state, machine);
+		waitForInterrupt8080(state, clock, deadline);
+	}
+}
+
+static uint64_t profile(const u8* rom, Movie* movie, int frames) {
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+	machineMapMemory(machine, state, rom);
+	int64_t clock = 0;
+	for (int f = 0; f < frames; f++) {
+		playFrame(movie, machine, f);
+		int64_t frameStart = (int64_t)f * CYCLES_PER_FRAME;
+		profileUntil(state, machine, &clock, frameStart + CYCLES_PER_HALF_FRAME);
+		VBlankHalfInterrupt(machine, state);
+		profileUntil(state, machine, &clock, frameStart + CYCLES_PER_FRAME);
+		VBlankFullInterrupt(machine, state);
+	}
+	freeState8080(state);
+	free(machine);
+	uint64_t total = 0;
+	for (int i = 0; i < MEM_SZ; i++) total += pcCounts[i];
+	return total;
+}
+
+static void addPattern(Pattern* patterns, int* num, int len, const u8* ops, uint64_t count) {
+	for (int i = 0; i < *num; i++) {
+		if (patterns[i].len == len && !memcmp(patterns[i].ops, ops, len)) {
+			patterns[i].count += count;
+			return;
+		}
+	}
+	if (*num == MAX_PATTERNS) return;
+	patterns[*num].len = len;
+	memcpy(patterns[*num].ops, ops, len);
+	patterns[*num].count = count;
+	(*num)++;
+}
+
+// dispatches saved, the hottest first
+static int bySaving(const void* a, const void* b) {
+	const Pattern* x = a;
+	const Pattern* y = b;
+	uint64_t sx = x->count * (x->len - 1), sy = y->count * (y->len - 1);
+	return sx < sy ? 1 : sx > sy ? -1 : 0;
+}
+
+static void writeFused(FILE* out, Pattern* patterns, int num, int max, uint64_t total, const char* source) {
+	fprintf(out, "// generated by fusegen from %s (%llu instructions), don't edit\n", source, (unsigned long long)total);
+	fprintf(out, "// FUSE2/FUSE3 are defined by whoever includes this, hottest first\n");
+	for (int i = 0; i < num && i < max; i++) {
+		Pattern* p = &patterns[i];
+		if (p->len == 2) fprintf(out, "FUSE2(0x%02X, 0x%02X)", p->ops[0], p->ops[1]);
+		else fprintf(out, "FUSE3(0x%02X, 0x%02X, 0x%02X)", p->ops[0], p->ops[1], p->ops[2]);
+		fprintf(out, " //");
+		for (int j = 0; j < p->len; j++) {
+			char buffer[64];
+			disassemble8080(buffer, p->ops[j], 0, 0, 0);
+			// squash the tab alignment, operands show up as 00/0000
+			fprintf(out, " ");
+			for (char* c = buffer; *c; c++) {
+				if (*c != '\t' && *c != ' ') fputc(*c, out);
+				else if (c[1] != '\t' && c[1] != ' ' && c[1] != '\0') fputc(' ', out);
+			}
+			if (j < p->len - 1) fputc(';', out);
+		}
+		fprintf(out, ", %.1f%% of instructions\n", 100.0 * p->count * p->len / total);
+	}
+}
+
+static int generate(const char* movieName, int frames, int max, const char* outName) {
+	const u8* rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	Movie* movie = movieName != NULL ? loadMovie(movieName) : initMovie();
+	if (movie == NULL) return 1;
+	if (frames < 0) frames = movie->frames > 0 ? movie->frames : 3600;
+	uint64_t total = profile(rom, movie, frames);
+
+	// the pairs and triples starting at each executed PC, only the last may leave straight line code
+	Pattern* patterns = malloc(MAX_PATTERNS * sizeof(Pattern));
+	int num = 0;
+	for (int pc = 0; pc < ROM_SZ; pc++) {
+		if (pcCounts[pc] == 0) continue;
+		u8 ops[3];
+		int p = pc;
+		for (int len = 1; len <= 3; len++) {
+			if (p >= ROM_SZ) break;
+			ops[len-1] = rom[p];
+			if (len > 1) addPattern(patterns, &num, len, ops, pcCounts[pc]);
+			// EI has to be last too, the instruction after it runs through nextOp8080
+			if (flowKind8080(rom[p]) != FLOW_NEXT || rom[p] == 0xFB) break;
+			p += opSize8080(rom[p]);
+		}
+	}
+	qsort(patterns, num, sizeof(Pattern), bySaving);
+
+	FILE* out = fopen(outName, "w");
+	if (out == NULL) {
+		printf("Could not write %s\n", outName);
+		return 1;
+	}
+	writeFused(out, patterns, num, max, total, movieName != NULL ? movieName : "attract mode");
+	fclose(out);
+	printf("%s: %d of %d sequences from %d frames, rebuild to use them\n", outName, num < max ? num : max, num, frames);
+	return 0;
+}
+
+static void randomize(State8080* state, const u8* memory) {
+	memcpy(state->memory, memory, MEM_SZ);
+	for (int i = 0; i < 8; i++) state->regs[i] = rand();
+	state->psw = (rand() & ~0x28) | 2;
+	state->sp = rand();
+	state->interruptsEnabled = rand() & 1;
+}
+
+static bool sameState(State8080* a, State8080* b, Machine* ma, Machine* mb) {
+	return !memcmp(a->regs, b->regs, 8) && a->psw == b->psw && a->pc == b->pc && a->sp == b->sp
+		&& a->halted == b->halted && a->interruptsEnabled == b->interruptsEnabled
+		&& !memcmp(a->memory, b->memory, MEM_SZ) && !memcmp(ma, mb, sizeof(Machine));
+}
+
+// each fused handler against its instructions one at a time through emulateOp8080,
+// from random registers, flags and memory with the sequence (and random operands) at a random PC
+// in read-only memory, as it would be in the ROM (so it can't overwrite itself)
+static int check(int trials) {
+	u8* memory = malloc(MEM_SZ);
+	State8080* a = initState8080();
+	State8080* b = initState8080();
+	mapMemory8080(a, 0, ROM_SZ, a->memory, NULL);
+	mapMemory8080(b, 0, ROM_SZ, b->memory, NULL);
+	Machine* ma = initMachine();
+	Machine* mb = initMachine();
+	int failures = 0;
+	for (int i = 0; i < numFusedOps8080; i++) {
+		const FusedOp* f = &fusedOps8080[i];
+		int bad = 0;
+		for (int t = 0; t < trials && bad == 0; t++) {
+			if (t % 256 == 0) for (int j = 0; j < MEM_SZ; j++) memory[j] = rand();
+			u16 pc = rand() % (ROM_SZ - 8);
+			u16 p = pc;
+			for (int j = 0; j < f->len; j++) {
+				memory[p] = f->ops[j];
+				// the machine only has ports 0-3 to read
+				if (f->ops[j] == 0xDB) memory[p+1] &= 3;
+				p += opSize8080(f->ops[j]);
+			}
+			randomize(a, memory);
+			memcpy(b->memory, a->memory, MEM_SZ);
+			memcpy(b->regs, a->regs, 8);
+			b->psw = a->psw;
+			b->sp = a->sp;
+			b->interruptsEnabled = a->interruptsEnabled;
+			a->halted = b->halted = false;
+			memset(ma, 0, sizeof(Machine));
+			memset(mb, 0, sizeof(Machine));
+			ma->board = mb->board = &boards[0];
+
+			int fused = f->handler(a, ma, pc);
+			int single = 0;
+			b->pc = pc;
+			for (int j = 0; j < f->len; j++) {
+				u16 at = b->pc;
+				b->pc = at + 1;
+				single += emulateOp8080(b, mb, fetchMem(b, at), fetchMem(b, at + 1), fetchMem(b, at + 2));
+			}
+			if (fused != single || !sameState(a, b, ma, mb)) bad++;
+		}
+		printf("%-4s", bad ? "FAIL" : "ok");
+		for (int j = 0; j < f->len; j++) printf(" %02X", f->ops[j]);
+		printf("\n");
+		failures += bad;
+	}
+	printf("%d fused handlers, %d failed\n", numFusedOps8080, failures);
+	free(memory);
+	return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	const char* movieName = NULL;
+	const char* outName = "fused.h";
+	int frames = -1;
+	int max = 32;
+	int trials = 10000;
+	bool checking = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-m") && i + 1 < argc) movieName = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-k") && i + 1 < argc) max = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) outName = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) trials = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-c")) checking = true;
+		else {
+			printf("usage: %s [-m movie] [-n frames] [-k max] [-o fused.h]\n", argv[0]);
+			printf("       %s -c [-t trials]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (checking) return check(trials);
+	return generate(movieName, frames, max, outName);
+}
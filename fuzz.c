@@ -0,0 +1,315 @@
+// coverage-guided input fuzzer: looks for inputs that reach code and game states nothing
+// has reached yet (the saucer scoring, extra ships, game over, two player games...)
+// keeps a corpus of snapshots, each one the first frame some input reached a new ROM PC or a
+// new cell (a coarse summary of the game state read from RAM, see cellOf), and from then on
+// restores one of them, plays a few seconds of random held inputs on ports 1 and 2 from there
+// and adds a snapshot wherever that finds something new, on every core at once
+// Space Invaders only (the cells come from gamestate.h), on the idle engine (coverage needs the
+// interpreter)
+//
+// usage: ./fuzz [-j threads] [-T seconds] [-m movie]... [-o dir] [-x file]
+//   -m  a movie to seed the corpus with, played from power on
+//   -o  save the corpus as movies (from power on) to dir/<n>.mov, for headless or platform -p
+//   -x  the coverage everything reached, for covmerge
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "movie.h"
+#include "snapshot.h"
+#include "gamestate.h"
+#include "coverage.h"
+#include "rom.h"
+#include "platform.h"
+
+#define MAX_SEEDS 64
+#define MAX_CORPUS (1<<16)
+#define CELLS_SZ (1<<20) // open addressed, far more than the coarse cells there are
+#define MIN_CHUNK 60 // frames of random input per trip out from a corpus entry
+#define MAX_CHUNK 600
+
+typedef struct Entry {
+	Snapshot* snap;
+	struct Entry* parent; // NULL for power on
+	Movie* inputs; // the frames from parent's snapshot to this one
+	int picks;
+} Entry;
+
+static const Engine* engine;
+static const u8* rom;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static Entry* corpus[MAX_CORPUS];
+static int corpusSize;
+static uint64_t cells[CELLS_SZ]; // cell + 1, 0 is empty
+static int numCells;
+static Coverage* reached; // executed PCs of every worker, ORed in as they're found
+static _Atomic int numPcs;
+static _Atomic int64_t framesRun;
+static _Atomic bool stop;
+
+typedef struct Worker {
+	State8080* state;
+	Machine* machine;
+	Coverage* coverage;
+	uint64_t rng;
+	pthread_t thread;
+} Worker;
+
+static uint64_t nextRandom(uint64_t* rng) {
+	*rng ^= *rng << 13;
+	*rng ^= *rng >> 7;
+	*rng ^= *rng << 17;
+	return *rng;
+}
+
+// the parts of the game state that make it a different situation rather than just a different
+// moment of the same one, packed into a word
+static uint64_t cellOf(const GameState* g) {
+	uint64_t cell = g->playing;
+	cell = cell << 1 | g->twoPlayers;
+	cell = cell << 1 | g->player;
+	cell = cell << 1 | g->playerAlive;
+	cell = cell << 1 | g->saucerActive;
+	cell = cell << 2 | (g->credits < 2 ? g->credits : 2);
+	cell = cell << 4 | (g->ships[0] & 0xF);
+	cell = cell << 4 | (g->ships[1] & 0xF);
+	cell = cell << 3 | g->aliensLeft >> 3;
+	cell = cell << 6 | g->scores[0] / 200;
+	cell = cell << 6 | g->scores[1] / 200;
+	return cell;
+}
+
+// true if cell wasn't there before, call with lock held
+static bool addCell(uint64_t cell) {
+	if (numCells >= CELLS_SZ / 2) return false;
+	uint64_t key = cell + 1;
+	for (uint32_t i = (key * 0x9E3779B97F4A7C15ull) >> 44;; i = (i + 1) & (CELLS_SZ - 1)) {
+		if (cells[i] == key) return false;
+		if (cells[i] == 0) {
+			cells[i] = key;
+			numCells++;
+			return true;
+		}
+	}
+}
+
+// PCs in state's coverage nobody had reached, now marked reached
+static int newPcs(Coverage* cov) {
+	uint64_t* local = (uint64_t*)cov->executed;
+	_Atomic uint64_t* global = (_Atomic uint64_t*)reached->executed;
+	int found = 0;
+	for (int i = 0; i < COVERAGE_EXECUTED_SZ / 8; i++) {
+		uint64_t bits = local[i] & ~atomic_load_explicit(&global[i], memory_order_relaxed);
+		if (bits == 0) continue;
+		bits &= ~atomic_fetch_or_explicit(&global[i], bits, memory_order_relaxed);
+		found += __builtin_popcountll(bits);
+	}
+	if (found > 0) atomic_fetch_add(&numPcs, found);
+	return found;
+}
+
+// call with lock held, false once the corpus is full
+static bool addEntry(Worker* w, Entry* parent, Movie* inputs, int64_t clock) {
+	if (corpusSize == MAX_CORPUS) return false;
+	Entry* e = malloc(sizeof(Entry));
+	e->snap = initSnapshot(w->state);
+	saveSnapshot(e->snap, w->state, w->machine, clock);
+	e->parent = parent;
+	e->inputs = inputs;
+	e->picks = 0;
+	corpus[corpusSize++] = e;
+	return true;
+}
+
+// a few at random, the one least picked so far, so new entries get their turn quickly
+// but nothing is left out for good
+static Entry* pickEntry(uint64_t* rng) {
+	pthread_mutex_lock(&lock);
+	Entry* best = NULL;
+	for (int i = 0; i < 4; i++) {
+		Entry* e = corpus[nextRandom(rng) % corpusSize];
+		if (best == NULL || e->picks < best->picks) best = e;
+	}
+	best->picks++;
+	pthread_mutex_unlock(&lock);
+	return best;
+}
+
+// held inputs for a random number of frames, mostly moving and firing, sometimes a coin or a start
+static void randomRun(uint64_t* rng, u8* p1, u8* p2, int* frames) {
+	uint64_t r = nextRandom(rng);
+	*frames = 1 + (r & 31);
+	r >>= 5;
+	u8 moves[] = {0x00, 0x20, 0x40, 0x00};
+	u8 move = moves[r & 3];
+	bool shot = (r >> 2) & 1;
+	*p1 = move | (shot ? 0x10 : 0);
+	*p2 = *p1;
+	r >>= 3;
+	if ((r & 63) == 0) *p1 |= 0x01; // coin
+	else if ((r & 63) == 1) *p1 |= 0x04; // 1p start
+	else if ((r & 63) == 2) *p1 |= 0x02; // 2p start
+	if ((r & 63) < 3) *frames = 1 + (*frames & 3);
+}
+
+// plays inputs from where e left off, adding an entry whenever a frame reaches something new
+// (each new entry's inputs are the frames since the last one, so the chain replays from power on)
+// fills the rest in at random past the end of inputs, up to frames
+static void explore(Worker* w, Entry* e, const Movie* inputs, int frames) {
+	int64_t clock;
+	restoreSnapshot(e->snap, w->state, w->machine, &clock);
+	Movie* since = initMovie();
+	int run = 0;
+	u8 p1 = 0, p2 = 0;
+	int f = 0;
+	for (; f < frames && !atomic_load_explicit(&stop, memory_order_relaxed); f++) {
+		if (inputs != NULL && f < inputs->frames) {
+			p1 = inputs->inputs[f][0];
+			p2 = inputs->inputs[f][1];
+		}
+		else if (run-- <= 0) randomRun(&w->rng, &p1, &p2, &run);
+		w->machine->rports[1] = (w->machine->rports[1] & ~MOVIE_MASK1) | p1;
+		w->machine->rports[2] = (w->machine->rports[2] & ~MOVIE_MASK2) | p2;
+		appendFrame(since, p1, p2);
+		runFrame(engine, w->state, w->machine, &clock);
+
+		GameState game;
+		readGameState(w->state, &game);
+		int pcs = newPcs(w->coverage);
+		pthread_mutex_lock(&lock);
+		bool cell = addCell(cellOf(&game));
+		bool added = (pcs > 0 || cell) && addEntry(w, e, since, clock);
+		if (added) e = corpus[corpusSize - 1];
+		pthread_mutex_unlock(&lock);
+		if (added) since = initMovie();
+	}
+	atomic_fetch_add_explicit(&framesRun, f, memory_order_relaxed);
+	freeMovie(since);
+}
+
+static void* worker(void* arg) {
+	Worker* w = arg;
+	while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		Entry* e = pickEntry(&w->rng);
+		int frames = MIN_CHUNK + nextRandom(&w->rng) % (MAX_CHUNK - MIN_CHUNK);
+		explore(w, e, NULL, frames);
+	}
+	return NULL;
+}
+
+static Worker* initWorker(uint64_t seed) {
+	Worker* w = calloc(1, sizeof(Worker));
+	w->state = initState8080();
+	w->machine = initMachine();
+	machineMapMemory(w->machine, w->state, rom);
+	if (!attachEngine(engine, w->state)) return NULL;
+	w->coverage = initCoverage();
+	attachCoverage(w->state, w->coverage, true);
+	w->rng = seed * 0x9E3779B97F4A7C15ull | 1;
+	return w;
+}
+
+// the frames from power on to e, parents first
+static void appendInputs(Movie* movie, const Entry* e) {
+	if (e->parent != NULL) appendInputs(movie, e->parent);
+	if (e->inputs == NULL) return;
+	for (int f = 0; f < e->inputs->frames; f++) appendFrame(movie, e->inputs->inputs[f][0], e->inputs->inputs[f][1]);
+}
+
+static bool saveCorpus(const char* dir) {
+	char name[1024];
+	for (int i = 0; i < corpusSize; i++) {
+		Movie* movie = initMovie();
+		appendInputs(movie, corpus[i]);
+		snprintf(name, sizeof(name), "%s/%05d.mov", dir, i);
+		bool ok = saveMovie(movie, name);
+		freeMovie(movie);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int seconds = 60;
+	const char* seeds[MAX_SEEDS];
+	int numSeeds = 0;
+	const char* corpusDir = NULL;
+	const char* coverageName = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-j") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-T") && i + 1 < argc) seconds = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc && numSeeds < MAX_SEEDS) seeds[numSeeds++] = argv[++i];
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) corpusDir = argv[++i];
+		else if (!strcmp(argv[i], "-x") && i + 1 < argc) coverageName = argv[++i];
+		else {
+			printf("usage: %s [-j threads] [-T seconds] [-m movie]... [-o dir] [-x file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (threads < 1) threads = 1;
+	engine = findEngine("idle");
+	if (engine == NULL) return 1;
+	rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	reached = initCoverage();
+
+	Worker** workers = malloc(threads * sizeof(Worker*));
+	for (int i = 0; i < threads; i++) {
+		workers[i] = initWorker(i + 1);
+		if (workers[i] == NULL) return 1;
+	}
+
+	// power on, then the seeds played from it (finding whatever they find on the way)
+	addEntry(workers[0], NULL, NULL, 0);
+	Entry* powerOn = corpus[0];
+	for (int i = 0; i < numSeeds; i++) {
+		Movie* seed = loadMovie(seeds[i]);
+		if (seed == NULL) return 1;
+		explore(workers[0], powerOn, seed, seed->frames);
+		freeMovie(seed);
+	}
+	printf("%d seeds: %d entries, %d PCs, %d cells\n", numSeeds, corpusSize, atomic_load(&numPcs), numCells);
+
+	int64_t start = currNano();
+	for (int i = 0; i < threads; i++) pthread_create(&workers[i]->thread, NULL, worker, workers[i]);
+	int lastPcs = atomic_load(&numPcs), lastCells = numCells;
+	int64_t lastFrames = 0;
+	for (int s = 1; s <= seconds; s++) {
+		// keep to the wall clock rather than drifting a little every second
+		int64_t wait = start + s * 1000000000ll - currNano();
+		if (wait > 0) usleep(wait / 1000);
+		pthread_mutex_lock(&lock);
+		int entries = corpusSize, cellCount = numCells;
+		pthread_mutex_unlock(&lock);
+		int pcs = atomic_load(&numPcs);
+		int64_t frames = atomic_load(&framesRun);
+		printf("%4d s %8lld frames/s %6d entries %5d PCs (+%d) %5d cells (+%d)\n", s,
+			(long long)(frames - lastFrames), entries, pcs, pcs - lastPcs, cellCount, cellCount - lastCells);
+		fflush(stdout);
+		lastPcs = pcs;
+		lastCells = cellCount;
+		lastFrames = frames;
+	}
+	atomic_store(&stop, true);
+	for (int i = 0; i < threads; i++) pthread_join(workers[i]->thread, NULL);
+	printf("%lld frames in %.1f s on %d threads: %d entries, %d PCs, %d cells\n", (long long)atomic_load(&framesRun),
+		(currNano() - start) / 1e9, threads, corpusSize, atomic_load(&numPcs), numCells);
+
+	if (coverageName != NULL) {
+		for (int i = 0; i < threads; i++) {
+			for (int j = 0; j < COVERAGE_BRANCHES_SZ; j++) reached->branches[j] |= workers[i]->coverage->branches[j];
+		}
+		if (!saveCoverage(reached, coverageName)) return 1;
+	}
+	if (corpusDir != NULL && !saveCorpus(corpusDir)) return 1;
+	return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gamestate.h"
+
+// 4 BCD digits, low byte first
+static uint16_t bcd16(const u8* bcd) {
+	return (bcd[1] >> 4) * 1000 + (bcd[1] & 0xF) * 100 + (bcd[0] >> 4) * 10 + (bcd[0] & 0xF);
+}
+
+void readGameState(const State8080* state, GameState* out) {
+	const InvadersRam* ram = invadersRam(state);
+	int player = ram->playerData == 0x22;
+	const PlayerRam* current = &ram->players[player];
+
+	out->playing = ram->gameMode == 1;
+	out->twoPlayers = out->playing && ram->twoPlayers == 1;
+	out->player = player;
+	out->credits = (ram->credits >> 4) * 10 + (ram->credits & 0xF);
+	out->hiScore = bcd16(ram->hiScore);
+	for (int i = 0; i < 2; i++) {
+		out->scores[i] = bcd16(ram->scores[i]);
+		out->ships[i] = ram->players[i].ships;
+	}
+	out->playerAlive = ram->playerAlive == 0xFF;
+	out->playerX = ram->playerX - INVADERS_X_BIAS;
+
+	uint64_t aliens = 0;
+	for (int i = 0; i < INVADERS_ALIENS; i++) {
+		if (current->aliens[i]) aliens |= (uint64_t)1 << i;
+	}
+	out->aliens = aliens;
+	out->aliensLeft = __builtin_popcountll(aliens);
+	out->alienX = ram->alienX - INVADERS_X_BIAS;
+	out->alienY = ram->alienY;
+
+	out->playerShot.active = ram->playerShotStatus != 0;
+	out->playerShot.x = ram->playerShotX - INVADERS_X_BIAS;
+	out->playerShot.y = ram->playerShotY;
+	for (int i = 0; i < 3; i++) {
+		const AlienShotRam* shot = &ram->alienShots[i];
+		out->alienShots[i].active = (shot->status & 0x80) != 0;
+		out->alienShots[i].x = shot->x - INVADERS_X_BIAS;
+		out->alienShots[i].y = shot->y;
+	}
+	out->saucerActive = ram->saucerActive != 0;
+	out->saucerX = ram->saucerX - INVADERS_X_BIAS;
+}
+
+void readGameStates(State8080* const* states, int n, GameState* out) {
+	for (int i = 0; i < n; i++) {
+		// the next instance's RAM is on its way in while this one is decoded
+		if (i + 1 < n) {
+			for (int line = 0; line < 0x140; line += 64) __builtin_prefetch(states[i+1]->memory + INVADERS_RAM + line);
+		}
+		readGameState(states[i], &out[i]);
+	}
+}
+
+void printGameState(FILE* f, int frame, const GameState* g) {
+	fprintf(f, "{\"frame\":%d,\"playing\":%d,\"two_players\":%d,\"player\":%d,\"credits\":%d,\"hi_score\":%d,\"scores\":[%d,%d],\"ships\":[%d,%d]",
+		frame, g->playing, g->twoPlayers, g->player, g->credits, g->hiScore, g->scores[0], g->scores[1], g->ships[0], g->ships[1]);
+	fprintf(f, ",\"player_alive\":%d,\"player_x\":%d,\"aliens_left\":%d,\"aliens\":\"%014llx\",\"alien_x\":%d,\"alien_y\":%d",
+		g->playerAlive, g->playerX, g->aliensLeft, (unsigned long long)g->aliens, g->alienX, g->alienY);
+	fprintf(f, ",\"shots\":[");
+	for (int i = 0; i < 4; i++) {
+		const Shot* s = i == 0 ? &g->playerShot : &g->alienShots[i-1];
+		if (s->active) fprintf(f, "%s[%d,%d]", i ? "," : "", s->x, s->y);
+		else fprintf(f, "%snull", i ? "," : "");
+	}
+	fprintf(f, "],\"saucer_x\":");
+	if (g->saucerActive) fprintf(f, "%d}\n", g->saucerX);
+	else fprintf(f, "null}\n");
+}
@@ -0,0 +1,114 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "emulate8080.h"
+
+// what Space Invaders keeps in work RAM, laid over State8080.memory at 0x2000 so a field is
+// read straight out of the emulated RAM with no copying, only the parts we know are named
+// the game keeps positions as a VRAM address relative to 0x2000 would have them: y is the
+// bit up from the bottom of the screen and x is the column + 32 (INVADERS_X_BIAS)
+#define INVADERS_RAM 0x2000
+#define INVADERS_ALIENS 55 // 5 rows of 11
+#define INVADERS_ALIEN_COLS 11
+#define INVADERS_X_BIAS 32
+
+// an alien shot, rolling at 0x2030, plunger at 0x2040 and squiggly at 0x2050
+typedef struct AlienShotRam {
+	u8 _pad0[5];
+	u8 status; // bit 7 set while it's falling
+	u8 _pad1[7];
+	u8 y;
+	u8 x;
+	u8 _pad2;
+} AlienShotRam;
+
+// per player, at 0x2100 and 0x2200
+typedef struct PlayerRam {
+	u8 aliens[INVADERS_ALIENS]; // 1 if still alive, bottom left first, a row at a time
+	u8 _pad0[0xFF - INVADERS_ALIENS];
+	u8 ships; // left to play after the one in play
+} PlayerRam;
+
+typedef struct InvadersRam {
+	u8 _pad0[0x09];
+	u8 alienY; // 0x2009, the bottom left alien of the current rack (dead or not)
+	u8 alienX;
+	u8 _pad1[0x15 - 0x0B];
+	u8 playerAlive; // 0x2015, 0xFF until hit
+	u8 _pad2[0x1B - 0x16];
+	u8 playerX; // 0x201B
+	u8 _pad3[0x25 - 0x1C];
+	u8 playerShotStatus; // 0x2025, 0 while it can fire
+	u8 _pad4[0x29 - 0x26];
+	u8 playerShotY; // 0x2029
+	u8 playerShotX;
+	u8 _pad5[0x30 - 0x2B];
+	AlienShotRam alienShots[3]; // 0x2030
+	u8 _pad6[0x67 - 0x60];
+	u8 playerData; // 0x2067, high byte of the current player's PlayerRam (0x21 or 0x22)
+	u8 _pad7[0x84 - 0x68];
+	u8 saucerActive; // 0x2084
+	u8 _pad8[0x8A - 0x85];
+	u8 saucerX; // 0x208A
+	u8 _pad9[0xCE - 0x8B];
+	u8 twoPlayers; // 0x20CE
+	u8 _pad10[0xEB - 0xCF];
+	u8 credits; // 0x20EB, BCD
+	u8 _pad11[0xEF - 0xEC];
+	u8 gameMode; // 0x20EF, 1 while a game is running rather than attract mode
+	u8 _pad12[0xF4 - 0xF0];
+	u8 hiScore[2]; // 0x20F4, BCD, low byte first
+	u8 _pad13[2];
+	u8 scores[2][4]; // 0x20F8 and 0x20FC, BCD, low byte first, then where it's drawn
+	PlayerRam players[2]; // 0x2100
+} InvadersRam;
+
+_Static_assert(offsetof(InvadersRam, playerX) == 0x1B, "InvadersRam layout");
+_Static_assert(offsetof(InvadersRam, alienShots) == 0x30, "InvadersRam layout");
+_Static_assert(offsetof(InvadersRam, gameMode) == 0xEF, "InvadersRam layout");
+_Static_assert(offsetof(InvadersRam, scores) == 0xF8, "InvadersRam layout");
+_Static_assert(offsetof(InvadersRam, players) == 0x100, "InvadersRam layout");
+_Static_assert(sizeof(InvadersRam) == 0x300, "InvadersRam layout");
+
+static inline const InvadersRam* invadersRam(const State8080* state) {
+	return (const InvadersRam*)(state->memory + INVADERS_RAM);
+}
+
+typedef struct Shot {
+	bool active;
+	u8 x, y;
+} Shot;
+
+// the decoded state, small enough to keep one per frame
+// positions are screen pixels of the sprite's bottom left, x from the left and y up from the bottom
+typedef struct GameState {
+	bool playing; // false in attract mode, when the rest is whatever the demo left behind
+	bool twoPlayers;
+	u8 player; // whose turn, 0 or 1
+	u8 credits;
+	uint16_t hiScore;
+	uint16_t scores[2];
+	u8 ships[2]; // left after the one in play
+	bool playerAlive;
+	u8 playerX;
+	u8 aliensLeft; // the current player's
+	uint64_t aliens; // bit row * 11 + col set if alive, row 0 at the bottom, col 0 on the left
+	u8 alienX, alienY; // the bottom left alien, the others are 16 pixels apart each way
+	Shot playerShot;
+	Shot alienShots[3]; // rolling, plunger, squiggly
+	bool saucerActive;
+	u8 saucerX;
+} GameState;
+
+void readGameState(const State8080* state, GameState* out);
+// the same for n instances at once, out[i] from states[i]
+void readGameStates(State8080* const* states, int n, GameState* out);
+// one JSON object per line, shots as [x,y] (player's first) or null
+void printGameState(FILE* f, int frame, const GameState* g);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// XXH64, same output as the reference xxHash
+uint64_t xxh64(const void* data, size_t len, uint64_t seed);
+
+#endif
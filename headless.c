@@ -0,0 +1,152 @@
+// runs the game with no window, as fast as it will go, for batch jobs
+// (replaying movies, dumping video of them)
+//
+// usage: ./headless [-b board] [-e engine] [-m movie] [-n frames] [-c file] [-s scale] [-t file] [-g file] [-x file | -X file] [-P name] [-R file]
+//   -b  one of the boards in board.c, ROMs in roms/ (default invaders)
+//   -c  capture every frame to file, .ppm/.y4m (or a %d pattern for one PPM per frame) else raw VRAM
+//   -s  pixel scale for PPM and Y4M (default 1)
+//   -g  the game state read from RAM every frame as JSON lines (Space Invaders only), - for stdout
+//   -x  coverage of the executed PCs for covmerge, -X with conditional branches too (interp and idle only)
+//   -R  the work RAM and ports as a stream of per frame changes (see ramstream.h and ramdump)
+//   -P  publish every frame to shared memory for other processes to watch (see shmwatch)
+//   -t  per frame cycles and core time, summarized every second as JSON lines (or CSV for .csv)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "movie.h"
+#include "capture.h"
+#include "telemetry.h"
+#include "gamestate.h"
+#include "coverage.h"
+#include "publish.h"
+#include "ramstream.h"
+#include "rom.h"
+#include "platform.h"
+
+int main(int argc, char** argv) {
+	const char* engineName = "interp";
+	const char* boardName = "invaders";
+	const char* movieName = NULL;
+	const char* captureName = NULL;
+	const char* telemetryName = NULL;
+	const char* stateName = NULL;
+	const char* coverageName = NULL;
+	const char* publishName = NULL;
+	const char* ramName = NULL;
+	bool coverBranches = false;
+	int frames = -1;
+	int scale = 1;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-e") && i + 1 < argc) engineName = argv[++i];
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc) boardName = argv[++i];
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc) movieName = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc) captureName = argv[++i];
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) scale = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) telemetryName = argv[++i];
+		else if (!strcmp(argv[i], "-g") && i + 1 < argc) stateName = argv[++i];
+		else if ((!strcmp(argv[i], "-x") || !strcmp(argv[i], "-X")) && i + 1 < argc) {
+			coverBranches = argv[i][1] == 'X';
+			coverageName = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-P") && i + 1 < argc) publishName = argv[++i];
+		else if (!strcmp(argv[i], "-R") && i + 1 < argc) ramName = argv[++i];
+		else {
+			printf("usage: %s [-b board] [-e engine] [-m movie] [-n frames] [-c file] [-s scale] [-t file] [-g file] [-x file | -X file] [-P name] [-R file]\n", argv[0]);
+			return 1;
+		}
+	}
+	const Engine* engine = findEngine(engineName);
+	if (engine == NULL) return 1;
+	const Board* board = findBoard(boardName);
+	if (board == NULL) return 1;
+	const u8* rom = loadBoardRom(board, "roms");
+	if (rom == NULL) return 1;
+	Movie* movie = movieName != NULL ? loadMovie(movieName) : initMovie();
+	if (movie == NULL) return 1;
+	if (frames < 0) frames = movie->frames > 0 ? movie->frames : 3600;
+
+	State8080* state = initState8080();
+	Machine* machine = initBoardMachine(board);
+	machineMapMemory(machine, state, rom);
+	if (!attachEngine(engine, state)) return 1;
+	// nothing is watching in real time, so every frame gets written even if that means waiting
+	Capture* capture = NULL;
+	if (captureName != NULL) {
+		capture = initCapture(captureName, captureFormatFor(captureName), scale, true);
+		if (capture == NULL) return 1;
+	}
+	Telemetry* telemetry = NULL;
+	TelemetryThread* frameTimes = NULL;
+	if (telemetryName != NULL) {
+		telemetry = initTelemetry(telemetryName, 1000);
+		if (telemetry == NULL) return 1;
+		frameTimes = telemetryThread(telemetry, "main");
+	}
+
+	// the other engines don't go through nextOp8080 for most instructions
+	Coverage* coverage = NULL;
+	if (coverageName != NULL) {
+		if (engine->run != engines[0].run) {
+			printf("coverage needs the interp or idle engine\n");
+			return 1;
+		}
+		coverage = initCoverage();
+		attachCoverage(state, coverage, coverBranches);
+	}
+	Publisher* publisher = NULL;
+	if (publishName != NULL) {
+		publisher = initPublisher(publishName);
+		if (publisher == NULL) return 1;
+	}
+	RamStream* ramStream = NULL;
+	if (ramName != NULL) {
+		ramStream = initRamStream(ramName, 0);
+		if (ramStream == NULL) return 1;
+	}
+	FILE* stateFile = NULL;
+	if (stateName != NULL) {
+		stateFile = strcmp(stateName, "-") ? fopen(stateName, "w") : stdout;
+		if (stateFile == NULL) {
+			printf("Could not write %s\n", stateName);
+			return 1;
+		}
+	}
+
+	int64_t clock = 0;
+	int64_t start = currNano();
+	for (int f = 0; f < frames; f++) {
+		playFrame(movie, machine, f);
+		int64_t before = clock, t0 = currNano();
+		runFrame(engine, state, machine, &clock);
+		if (frameTimes != NULL) {
+			telemetryRecord(frameTimes, TM_CYCLES, clock - before);
+			telemetryRecord(frameTimes, TM_CPU, currNano() - t0);
+			telemetryEndFrame(frameTimes);
+		}
+		if (stateFile != NULL) {
+			GameState game;
+			readGameState(state, &game);
+			printGameState(stateFile, f, &game);
+		}
+		if (capture != NULL) captureFrame(capture, state->memory + board->videoStart, f);
+		if (publisher != NULL) publishFrame(publisher, state, machine, f, clock);
+		if (ramStream != NULL) ramStreamFrame(ramStream, state, machine);
+	}
+	double secs = (currNano() - start) / 1e9;
+	if (capture != NULL) freeCapture(capture);
+	if (telemetry != NULL) freeTelemetry(telemetry);
+	if (stateFile != NULL && stateFile != stdout) fclose(stateFile);
+	if (publisher != NULL) freePublisher(publisher);
+	if (ramStream != NULL && !freeRamStream(ramStream)) return 1;
+	if (coverage != NULL && !saveCoverage(coverage, coverageName)) return 1;
+	printf("%d frames on %s in %.2f s (%.1f frames/s)\n", frames, engine->name, secs, frames / secs);
+	freeState8080(state);
+	free(machine);
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+#include "machine.h"
+
+static const char* keyNames[] = {"coin", "2p_start", "1p_start", "1p_shot", "1p_left", "1p_right", "2p_shot", "2p_left", "2p_right"};
+
+InputQueue* initInputQueue(const char* logPath) {
+	InputQueue* q = calloc(1, sizeof(InputQueue));
+	if (logPath == NULL) return q;
+	q->log = fopen(logPath, "w");
+	if (q->log == NULL) {
+		printf("Could not write %s\n", logPath);
+		free(q);
+		return NULL;
+	}
+	fprintf(q->log, "key,down,poll_cycle,apply_cycle,read_cycle,poll_to_read_us,read_to_present_us\n");
+	return q;
+}
+
+bool queueKey(InputQueue* q, enum MKey key, bool down, int64_t nano, int64_t cycle) {
+	if (q->head - q->tail == INPUT_QUEUE_SZ) return false;
+	InputEvent* e = &q->events[q->head++ % INPUT_QUEUE_SZ];
+	memset(e, 0, sizeof(InputEvent));
+	e->key = key;
+	e->down = down;
+	e->pollNano = nano;
+	e->pollCycle = cycle;
+	return true;
+}
+
+void applyInputs(InputQueue* q, Machine* mach, int64_t cycle) {
+	u16 changed = 0;
+	while (q->applied != q->head) {
+		InputEvent* e = &q->events[q->applied % INPUT_QUEUE_SZ];
+		// a second change to the same key waits for the next frame, as does everything after it
+		if (changed & (1 << e->key)) break;
+		changed |= 1 << e->key;
+		if (e->down) machineKeyDown(mach, e->key);
+		else machineKeyUp(mach, e->key);
+		e->applyCycle = cycle;
+		q->applied++;
+	}
+	// reads from before now can't have seen these
+	mach->portsRead = 0;
+}
+
+void inputPortsRead(InputQueue* q, Machine* mach, int64_t cycle, int64_t nano) {
+	for (uint32_t i = q->tail; i != q->applied; i++) {
+		InputEvent* e = &q->events[i % INPUT_QUEUE_SZ];
+		if (e->readCycle == 0 && (mach->portsRead & (1 << mach->board->keys[e->key].port))) {
+			e->readCycle = cycle;
+			e->readNano = nano;
+		}
+	}
+	mach->portsRead = 0;
+}
+
+void inputPresented(InputQueue* q, int64_t nano) {
+	for (uint32_t i = q->tail; i != q->applied; i++) {
+		InputEvent* e = &q->events[i % INPUT_QUEUE_SZ];
+		if (e->readCycle != 0 && e->presentNano == 0) e->presentNano = nano;
+	}
+	// done with everything seen on screen, in order
+	while (q->tail != q->applied && q->events[q->tail % INPUT_QUEUE_SZ].presentNano != 0) {
+		InputEvent* e = &q->events[q->tail++ % INPUT_QUEUE_SZ];
+		int64_t pressToRead = e->readNano - e->pollNano;
+		int64_t readToPresent = e->presentNano - e->readNano;
+		q->pressToRead += pressToRead;
+		q->readToPresent += readToPresent;
+		if (pressToRead > q->maxPressToRead) q->maxPressToRead = pressToRead;
+		if (readToPresent > q->maxReadToPresent) q->maxReadToPresent = readToPresent;
+		q->logged++;
+		if (q->log != NULL) {
+			fprintf(q->log, "%s,%d,%lld,%lld,%lld,%lld,%lld\n", keyNames[e->key], e->down,
+				(long long)e->pollCycle, (long long)e->applyCycle, (long long)e->readCycle,
+				(long long)(pressToRead / 1000), (long long)(readToPresent / 1000));
+		}
+	}
+}
+
+void freeInputQueue(InputQueue* q) {
+	if (q->logged > 0) {
+		printf("input lag over %d events: press to port read %.1f ms (worst %.1f), port read to screen %.1f ms (worst %.1f)\n",
+			q->logged, q->pressToRead / 1e6 / q->logged, q->maxPressToRead / 1e6,
+			q->readToPresent / 1e6 / q->logged, q->maxReadToPresent / 1e6);
+	}
+	if (q->log != NULL) fclose(q->log);
+	free(q);
+}
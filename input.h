@@ -0,0 +1,55 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+#define INPUT_QUEUE_SZ 256
+
+// a key press or release on its way from the host to the game
+// every stage is stamped so the lag between them can be measured
+typedef struct InputEvent {
+	enum MKey key;
+	bool down;
+	int64_t pollNano; // host time it came out of the event loop
+	int64_t pollCycle; // emulated cycle at that moment
+	int64_t applyCycle; // the frame boundary it was put on the port, 0 until then
+	int64_t readCycle; // the first IN of its port after that, 0 until then
+	int64_t readNano;
+	int64_t presentNano; // the first frame shown after the read
+} InputEvent;
+
+// events are only ever applied at frame boundaries (where movies record and play back),
+// at most one change per key per frame so a quick tap can't be pressed and released unseen
+// all on the emulator thread, the ring is just the order events are in
+typedef struct InputQueue {
+	InputEvent events[INPUT_QUEUE_SZ];
+	uint32_t head; // next free slot
+	uint32_t applied; // events before this are on the ports
+	uint32_t tail; // oldest event still waiting for its read or present
+	FILE* log; // NULL to not log
+	int logged;
+	int64_t pressToRead; // totals for the summary
+	int64_t readToPresent;
+	int64_t maxPressToRead;
+	int64_t maxReadToPresent;
+} InputQueue;
+
+// logPath (may be NULL) gets a CSV line per event once it's been seen on screen
+// NULL (after printing why) if it can't be opened
+InputQueue* initInputQueue(const char* logPath);
+// false if the queue is full, the caller should just apply the key then
+bool queueKey(InputQueue* q, enum MKey key, bool down, int64_t nano, int64_t cycle);
+// call at the frame boundary, before the frame is recorded
+void applyInputs(InputQueue* q, Machine* mach, int64_t cycle);
+// call when the game has read ports (mach->portsRead is set), clears them
+void inputPortsRead(InputQueue* q, Machine* mach, int64_t cycle, int64_t nano);
+// call after showing a frame
+void inputPresented(InputQueue* q, int64_t nano);
+// prints the average and worst lags and closes the log
+void freeInputQueue(InputQueue* q);
+
+#endif
@@ -0,0 +1,166 @@
+// runs the reference interpreter and a candidate engine side by side on the same ROM and inputs,
+// stopping at the first point their CPU state (or RAM, every so often) differs
+//
+// usage: ./lockstep [-e engine] [-m movie] [-n frames] [-i interval]
+//   -e  candidate engine (default interp)
+//   -m  input movie to play (default: no input, i.e. attract mode)
+//   -n  frames to run (default: the movie's length, or 3600)
+//   -i  compare RAM hashes every interval sync points (default 1000, 0 = never)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "disassemble.h"
+#include "engine.h"
+#include "movie.h"
+#include "rom.h"
+#include "platform.h"
+
+#define HISTORY 16
+
+typedef struct Side {
+	const Engine* engine;
+	State8080* state;
+	Machine* machine;
+	int64_t clock;
+} Side;
+
+// reference PCs leading up to the current sync point
+u16 history[HISTORY];
+int64_t historyLen = 0;
+
+static bool initSide(Side* side, const Engine* engine, const u8* rom) {
+	side->engine = engine;
+	side->state = initState8080();
+	side->machine = initMachine();
+	machineMapMemory(side->machine, side->state, rom);
+	side->clock = 0;
+	return attachEngine(engine, side->state);
+}
+
+static uint64_t hashRam(State8080* state) {
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < MEM_SZ; i++) {
+		h ^= state->memory[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static bool sameCpu(State8080* a, State8080* b) {
+	return !memcmp(a->regs, b->regs, 8) && a->psw == b->psw && a->pc == b->pc && a->sp == b->sp
+		&& a->halted == b->halted && a->interruptsEnabled == b->interruptsEnabled;
+}
+
+static void printCpu(const char* name, Side* side) {
+	State8080* s = side->state;
+	u8* r = s->regs;
+	printf("%-8s PC %04X SP %04X A %02X F %02X B %02X C %02X D %02X E %02X H %02X L %02X %s%s clock %lld\n",
+			name, s->pc, s->sp, r[REG_A], s->psw, r[REG_B], r[REG_C], r[REG_D], r[REG_E], r[REG_H], r[REG_L],
+			s->interruptsEnabled ? "EI" : "DI", s->halted ? " HALTED" : "", (long long)side->clock);
+}
+
+static void printListing(State8080* state, u16 pc, int n, char mark) {
+	char buffer[64];
+	for (int i = 0; i < n; i++) {
+		int sz = disassemble8080(buffer, fetchMem(state, pc), fetchMem(state, pc+1), fetchMem(state, pc+2), pc);
+		printf("%c %04X\t%s\n", i == 0 ? mark : ' ', pc, buffer);
+		pc += sz;
+	}
+}
+
+static void report(Side* ref, Side* cand, int frame, const char* what) {
+	printf("DIVERGED in frame %d: %s\n", frame, what);
+	printCpu(ref->engine->name, ref);
+	printCpu(cand->engine->name, cand);
+	printf("last instructions (reference):\n");
+	int64_t start = historyLen > HISTORY ? historyLen - HISTORY : 0;
+	for (int64_t i = start; i < historyLen; i++) printListing(ref->state, history[i % HISTORY], 1, ' ');
+	printf("reference continues at:\n");
+	printListing(ref->state, ref->state->pc, 4, '>');
+	printf("candidate continues at:\n");
+	printListing(cand->state, cand->state->pc, 4, '>');
+}
+
+// runs both sides up to deadline, syncing after every run of the candidate
+// (which may be a whole block) with the reference stepping one instruction at a time to catch up
+// (same halt/idle skipping as runUntil)
+// returns false on the first divergence
+static bool runSlice(Side* ref, Side* cand, int64_t deadline, int frame, int interval, int64_t* syncs) {
+	while (cand->clock < deadline) {
+		cand->clock += cand->engine->run(cand->state, cand->machine, deadline - cand->clock);
+		waitForInterrupt8080(cand->state, &cand->clock, deadline);
+		// the reference stops at the deadline, so a candidate that runs past it shows up as a cycle mismatch
+		while (ref->clock < cand->clock && ref->clock < deadline) {
+			history[historyLen++ % HISTORY] = ref->state->pc;
+			ref->clock += ref->engine->run(ref->state, ref->machine, 1);
+			waitForInterrupt8080(ref->state, &ref->clock, deadline);
+		}
+		if (ref->clock != cand->clock) {
+			report(ref, cand, frame, "cycle counts differ");
+			return false;
+		}
+		if (!sameCpu(ref->state, cand->state)) {
+			report(ref, cand, frame, "registers differ");
+			return false;
+		}
+		if (interval > 0 && ++*syncs % interval == 0 && hashRam(ref->state) != hashRam(cand->state)) {
+			report(ref, cand, frame, "RAM differs");
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* engineName = "interp";
+	const char* movieName = NULL;
+	int frames = -1;
+	int interval = 1000;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-e") && i + 1 < argc) engineName = argv[++i];
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc) movieName = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i") && i + 1 < argc) interval = atoi(argv[++i]);
+		else {
+			printf("usage: %s [-e engine] [-m movie] [-n frames] [-i interval]\n", argv[0]);
+			return 1;
+		}
+	}
+	const Engine* candidate = findEngine(engineName);
+	if (candidate == NULL) return 1;
+	const u8* rom = loadRom("roms");
+	if (rom == NULL) return 1;
+	Movie* movie = movieName != NULL ? loadMovie(movieName) : initMovie();
+	if (movie == NULL) return 1;
+	if (frames < 0) frames = movie->frames > 0 ? movie->frames : 3600;
+
+	Side ref, cand;
+	if (!initSide(&ref, &engines[0], rom) || !initSide(&cand, candidate, rom)) return 1;
+
+	int64_t syncs = 0;
+	int64_t start = currNano();
+	for (int frame = 0; frame < frames; frame++) {
+		playFrame(movie, ref.machine, frame);
+		playFrame(movie, cand.machine, frame);
+		int64_t frameStart = (int64_t)frame * CYCLES_PER_FRAME;
+		if (!runSlice(&ref, &cand, frameStart + CYCLES_PER_HALF_FRAME, frame, interval, &syncs)) return 1;
+		VBlankHalfInterrupt(ref.machine, ref.state);
+		VBlankHalfInterrupt(cand.machine, cand.state);
+		if (!runSlice(&ref, &cand, frameStart + CYCLES_PER_FRAME, frame, interval, &syncs)) return 1;
+		VBlankFullInterrupt(ref.machine, ref.state);
+		VBlankFullInterrupt(cand.machine, cand.state);
+	}
+	if (hashRam(ref.state) != hashRam(cand.state)) {
+		report(&ref, &cand, frames - 1, "RAM differs at the end");
+		return 1;
+	}
+	double secs = (currNano() - start) / 1e9;
+	printf("%s matches %s for %d frames (%lld sync points, %.2f s, %.1f frames/s)\n",
+			candidate->name, engines[0].name, frames, (long long)syncs, secs, frames / secs);
+	return 0;
+}
@@ -5,98 +5,67 @@
 #include <stdlib.h>
 #include "machine.h"
 #include "emulate8080.h"
+#include "rom.h"
 
-void VBlankHalfInterrupt(State8080* state) {
-	generateInterrupt(state, 0xCF, 0, 0);
+void VBlankHalfInterrupt(Machine* mach, State8080* state) {
+	generateInterrupt(state, mach->board->halfVector, 0, 0);
 }
 
-void VBlankFullInterrupt(State8080* state) {
-	generateInterrupt(state, 0xD7, 0, 0);
+void VBlankFullInterrupt(Machine* mach, State8080* state) {
+	generateInterrupt(state, mach->board->fullVector, 0, 0);
 }
 
 u8 readPort(Machine* mach, u8 port) {
-	return mach->rports[port];
+	mach->portsRead |= 1 << (port & 7);
+	return mach->rports[port & 7];
 }
 
 void writePort(Machine* mach, u8 port, u8 val) {
-	switch (port) {
-		case 2: mach->wport2 = val & 0x7; break; // first 3 bits
-		case 4: mach->wport4 = (mach->wport4>>8) | ((u16)val << 8); break;
-	}
-	// update rport3 to do the shift register stuff
-	mach->rports[3] = (mach->wport4 >> (8 - mach->wport2)) & 0xFF;
+	const Board* b = mach->board;
+	if (port == b->shiftCountPort) mach->wport2 = val & 0x7; // first 3 bits
+	else if (port == b->shiftDataPort) mach->wport4 = (mach->wport4>>8) | ((u16)val << 8);
+	else return;
+	// update the shifter's read port to do the shift register stuff
+	mach->rports[b->shiftReadPort] = (mach->wport4 >> (8 - mach->wport2)) & 0xFF;
 }
 
-Machine* initMachine() {
+Machine* initBoardMachine(const Board* board) {
 	Machine* m = malloc(sizeof(Machine));
-	memset(m->rports, 0, 4);
+	setupMachine(m, board);
+	return m;
+}
+
+void setupMachine(Machine* m, const Board* board) {
+	m->board = board;
+	memset(m->rports, 0, sizeof(m->rports));
+	memcpy(m->rports, board->ports, sizeof(board->ports));
 	m->wport2 = 0;
 	m->wport4 = 0;
-	return m;
+	m->portsRead = 0;
 }
 
-void machineKeyDown(Machine* mach, enum MKey key) {
-	switch (key) {
-		case MK_COIN:
-			mach->rports[1] |= 1;
-			break;
-		case MK_2P_START:
-			mach->rports[1] |= (1<<1);
-			break;
-		case MK_1P_START:
-			mach->rports[1] |= (1<<2);
-			break;
-		case MK_1P_SHOT:
-			mach->rports[1] |= (1<<4);
-			break;
-		case MK_1P_LEFT:
-			mach->rports[1] |= (1<<5);
-			break;
-		case MK_1P_RIGHT:
-			mach->rports[1] |= (1<<6);
-			break;
-		case MK_2P_SHOT:
-			mach->rports[2] |= (1<<4);
-			break;
-		case MK_2P_LEFT:
-			mach->rports[2] |= (1<<5);
-			break;
-		case MK_2P_RIGHT:
-			mach->rports[2] |= (1<<6);
-			break;
+Machine* initMachine() {
+	return initBoardMachine(&boards[0]);
+}
+
+void machineMapMemory(Machine* mach, State8080* state, const u8* rom) {
+	for (const MemRegion* r = mach->board->regions; r < mach->board->regions + BOARD_MAX_REGIONS; r++) {
+		switch (r->kind) {
+			case REGION_ROM: mapMemory8080(state, r->start, r->end, rom + r->start, NULL); break;
+			case REGION_RAM: mapMemory8080(state, r->start, r->end, state->memory + r->start, state->memory + r->start); break;
+			case REGION_MIRROR: mirrorMemory8080(state, r->start, r->end, r->src); break;
+		}
 	}
 }
 
+void machineKeyDown(Machine* mach, enum MKey key) {
+	InputBit bit = mach->board->keys[key];
+	mach->rports[bit.port] |= bit.mask;
+}
+
 void machineKeyUp(Machine* mach, enum MKey key) {
-	switch (key) {
-		case MK_COIN:
-			mach->rports[1] &= ~1;
-			break;
-		case MK_2P_START:
-			mach->rports[1] &= ~(1<<1);
-			break;
-		case MK_1P_START:
-			mach->rports[1] &= ~(1<<2);
-			break;
-		case MK_1P_SHOT:
-			mach->rports[1] &= ~(1<<4);
-			break;
-		case MK_1P_LEFT:
-			mach->rports[1] &= ~(1<<5);
-			break;
-		case MK_1P_RIGHT:
-			mach->rports[1] &= ~(1<<6);
-			break;
-		case MK_2P_SHOT:
-			mach->rports[2] &= ~(1<<4);
-			break;
-		case MK_2P_LEFT:
-			mach->rports[2] &= ~(1<<5);
-			break;
-		case MK_2P_RIGHT:
-			mach->rports[2] &= ~(1<<6);
-			break;
-	}
+	InputBit bit = mach->board->keys[key];
+	mach->rports[bit.port] &= ~bit.mask;
 }
 
 void rotateScreen(u8 input[SCREEN_WIDTH][SCREEN_HEIGHT/8], int output[SCREEN_HEIGHT][SCREEN_WIDTH]) {
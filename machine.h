@@ -5,30 +5,44 @@
 #define SCREEN_WIDTH 224
 #define SCREEN_HEIGHT 256 
 
+// 2 MHz at 60 Hz, the mid-screen interrupt comes halfway through
+#define FRAME_RATE 60
+#define CYCLES_PER_FRAME (CLOCK_SPEED / FRAME_RATE)
+#define CYCLES_PER_HALF_FRAME (CYCLES_PER_FRAME / 2)
+
 #include <stdint.h>
 
+#include "board.h"
+
 typedef uint8_t u8;
 typedef uint16_t u16;
 
-
-enum MKey {
-	MK_COIN, MK_2P_START, MK_1P_START, MK_1P_SHOT, MK_1P_LEFT, MK_1P_RIGHT, MK_2P_SHOT, MK_2P_LEFT, MK_2P_RIGHT
-};
-
 typedef struct SpaceInvadersMachine {
-	// read ports
-	u8 rports[4];
+	const Board* board;
+
+	// read ports, the shifter's is kept up to date on every write so a read is just a load
+	u8 rports[8];
 
 	// write ports
 	u8 wport2;
 	u16 wport4; // shift register
+
+	u8 portsRead; // a bit per read port read since last cleared, for measuring input lag
 } Machine;
 
 #include "emulate8080.h"
 
+// Space Invaders
 Machine* initMachine();
-void VBlankHalfInterrupt(State8080* state);
-void VBlankFullInterrupt(State8080* state);
+Machine* initBoardMachine(const Board* board);
+// the same in place
+void setupMachine(Machine* m, const Board* board);
+// the board's memory map, ROM pointing straight at the shared image (see loadBoardRom)
+// on Space Invaders that's ROM at [0x0000, 0x2000), RAM at [0x2000, 0x4000),
+// and the address decoder ignores A14/A15 so everything above mirrors that
+void machineMapMemory(Machine* mach, State8080* state, const u8* rom);
+void VBlankHalfInterrupt(Machine* mach, State8080* state);
+void VBlankFullInterrupt(Machine* mach, State8080* state);
 u8 readPort(Machine* mach, u8 port);
 void writePort(Machine* mach, u8 port, u8 val);
 void machineKeyDown(Machine* mach, enum MKey key);
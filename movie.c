@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "movie.h"
+#include "machine.h"
+
+Movie* initMovie() {
+	Movie* movie = malloc(sizeof(Movie));
+	movie->frames = 0;
+	movie->cap = 1024;
+	movie->inputs = malloc(movie->cap * sizeof(movie->inputs[0]));
+	return movie;
+}
+
+void freeMovie(Movie* movie) {
+	free(movie->inputs);
+	free(movie);
+}
+
+void appendFrame(Movie* movie, u8 p1, u8 p2) {
+	if (movie->frames == movie->cap) {
+		movie->cap *= 2;
+		movie->inputs = realloc(movie->inputs, movie->cap * sizeof(movie->inputs[0]));
+	}
+	movie->inputs[movie->frames][0] = p1 & MOVIE_MASK1;
+	movie->inputs[movie->frames][1] = p2 & MOVIE_MASK2;
+	movie->frames++;
+}
+
+Movie* loadMovie(const char* filename) {
+	FILE* f = fopen(filename, "r");
+	if (f == NULL) {
+		printf("Error loading file: %s\n", filename);
+		return NULL;
+	}
+	Movie* movie = initMovie();
+	char line[128];
+	int lineno = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		if (line[0] == '#' || line[0] == '\n') continue;
+		int count;
+		unsigned int p1, p2;
+		if (sscanf(line, "%d %x %x", &count, &p1, &p2) != 3 || count < 0) {
+			printf("Bad movie line %s:%d\n", filename, lineno);
+			fclose(f);
+			freeMovie(movie);
+			return NULL;
+		}
+		for (int i = 0; i < count; i++) appendFrame(movie, p1, p2);
+	}
+	fclose(f);
+	return movie;
+}
+
+bool saveMovie(Movie* movie, const char* filename) {
+	FILE* f = fopen(filename, "w");
+	if (f == NULL) {
+		printf("Could not write %s\n", filename);
+		return false;
+	}
+	for (int i = 0; i < movie->frames;) {
+		int j = i;
+		while (j < movie->frames && !memcmp(movie->inputs[j], movie->inputs[i], 2)) j++;
+		fprintf(f, "%d %02X %02X\n", j - i, movie->inputs[i][0], movie->inputs[i][1]);
+		i = j;
+	}
+	fclose(f);
+	return true;
+}
+
+void recordFrame(Movie* movie, Machine* mach) {
+	appendFrame(movie, mach->rports[1], mach->rports[2]);
+}
+
+void playFrame(Movie* movie, Machine* mach, int frame) {
+	u8 p1 = 0, p2 = 0;
+	if (frame < movie->frames) {
+		p1 = movie->inputs[frame][0];
+		p2 = movie->inputs[frame][1];
+	}
+	mach->rports[1] = (mach->rports[1] & ~MOVIE_MASK1) | p1;
+	mach->rports[2] = (mach->rports[2] & ~MOVIE_MASK2) | p2;
+}
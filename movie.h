@@ -0,0 +1,37 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+// only the player input bits of ports 1 and 2 are recorded, the DIP switches are left alone
+#define MOVIE_MASK1 0x77
+#define MOVIE_MASK2 0x70
+
+// an input movie is just what ports 1 and 2 held for each frame
+// on disk it's text, one "<frames> <port1> <port2>" line per run of identical frames (ports in hex)
+typedef struct Movie {
+	int frames;
+	int cap;
+	u8 (*inputs)[2];
+} Movie;
+
+Movie* initMovie();
+void freeMovie(Movie* movie);
+// returns NULL (after printing why) if the file can't be read
+Movie* loadMovie(const char* filename);
+bool saveMovie(Movie* movie, const char* filename);
+
+// appends p1 and p2 (masked) as the next frame
+void appendFrame(Movie* movie, u8 p1, u8 p2);
+// appends the machine's current input bits as the next frame
+void recordFrame(Movie* movie, Machine* mach);
+// sets the machine's input bits for frame, past the end counts as no buttons held
+void playFrame(Movie* movie, Machine* mach, int frame);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef OPS8080_H
+#define OPS8080_H
+
+// the building blocks of emulateOp8080 (stack, register pairs, flags and the ALU)
+// in a header so generated code (see recompile.c) does exactly the same thing
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "emulate8080.h"
+
+extern const u8 parityLookup[256];
+
+static inline u16 combine8(u8 lo, u8 hi) {
+	return (u16)hi<<8 | lo;
+}
+
+static inline void push8(State8080* state, u8 val) {
+	writeMem(state, --state->sp, val);
+}
+static inline void push16(State8080* state, u16 val) {
+	push8(state, (u8)(val>>8 & 0xFF));
+	push8(state, (u8)(val & 0xFF));
+}
+
+static inline u8 pop8(State8080* state) {
+	return readMem(state, state->sp++);
+}
+static inline u16 pop16(State8080* state) {
+	u8 lo = pop8(state);
+	u8 hi = pop8(state);
+	return combine8(lo, hi);
+}
+
+// rp = 0b11 can be either SP or PSW (A + status)
+static inline u8* dRegHi(State8080* state, u8 rp, bool psw) {
+	if (rp < 3) return &(state->regs[rp*2]);
+	else if (psw) return &(state->regs[REG_A]);
+	else return (u8*)(&(state->sp)) + 1; // little-endian!!!
+}
+static inline u8* dRegLo(State8080* state, u8 rp, bool psw) {
+	if (rp < 3) return &(state->regs[rp*2 + 1]);
+	else if (psw) return &(state->psw);
+	else return (u8*)(&(state->sp));
+}
+
+static inline u8 readReg(State8080* state, int reg) {
+	if (reg == REG_M) return readMem(state, combine8(readReg(state, REG_L), readReg(state, REG_H)));
+	else return state->regs[reg];
+}
+static inline void writeReg(State8080* state, int reg, u8 val) {
+	if (reg == REG_M) writeMem(state, combine8(readReg(state, REG_L), readReg(state, REG_H)), val);
+	else state->regs[reg] = val;
+}
+// b 0 or 1
+static inline void setFlag(State8080* state, enum Flag f, u8 b) {
+	state->psw = (state->psw & ~(1<<f)) | (b<<f);
+}
+static inline int getFlag(State8080* state, enum Flag f) {
+	return (state->psw >> f) & 1;
+}
+
+static inline void setSign(State8080* state, u8 val) {
+	setFlag(state, FLAG_S, (val>>7));
+}
+static inline void setZero(State8080* state, u8 val) {
+	setFlag(state, FLAG_Z, val == 0);
+}
+static inline void setParity(State8080* state, u8 val) {
+	/*
+	u8 ans = 1;
+	while (val > 0) {
+		ans ^= (val & 1);
+		val >>= 1;
+	}
+	*/
+	setFlag(state, FLAG_P, parityLookup[val]);
+}
+static inline void setNonCarryFlags(State8080* state, u8 val) {
+	setSign(state, val);
+	setZero(state, val);
+	setParity(state, val);
+}
+
+// ALU ops
+static inline u8 ALUadd(State8080* state, u8 x1, u8 x2, u8 carry) {
+	setFlag(state, FLAG_C, ((u16)x2+(u16)carry + (u16)x1 > 0xFF));
+	setFlag(state, FLAG_AC, (((x1 & 0xF) + (x2 & 0xF) + carry) & 0x10));
+	u8 y = (x1 + x2 + carry) & 0xFF;
+	setNonCarryFlags(state, y);
+	return y;
+}
+
+static inline u8 ALUsub(State8080* state, u8 x1, u8 x2, u8 carry) {
+	setFlag(state, FLAG_C, (u16)x2+(u16)carry > x1);
+	//setFlag(state, FLAG_AC, (x2 & 0xF) + (carry & 0xF) > (x1 & 0xF));
+	u8 y = (x1 - x2 - carry) & 0xFF;
+	setNonCarryFlags(state, y);
+	return y;
+	/*
+	some bs i stole from another guy's emulator cause i still don't understand how AC works in subtractions
+
+	u8 x2_ones = (~x2) & 0xFF;
+
+	u16 res16 = (u16)x1 + (u16)x2_ones + (u16)(carry ? 0 : 1);
+	u8 res8 = res16 & 0xFF;
+
+	setFlag(state, FLAG_C, !(res16 & 0x100));
+	setFlag(state, FLAG_AC, (((x1 & 0xF) + (x2_ones & 0xF) + (carry ? 0 : 1)) & 0x10)>>4);
+	setNonCarryFlags(state, res8);
+	*/
+	//printf("%X %X %X %X %X %X %X %X\n", x1, x2, carry, x2_ones, res16, res8, getFlag(state, FLAG_C), getFlag(state, FLAG_AC));
+	//return res8;
+}
+
+static inline u8 ALUand(State8080* state, u8 x1, u8 x2, bool affectAC) {
+	setFlag(state, FLAG_C, 0);
+	// LMAO
+	setFlag(state, FLAG_AC, affectAC & ((x1|x2)>>3));
+	u8 y = x1 & x2;
+	setNonCarryFlags(state, y);
+	return y;
+}
+
+static inline u8 ALUxor(State8080* state, u8 x1, u8 x2) {
+	setFlag(state, FLAG_C, 0);
+	setFlag(state, FLAG_AC, 0);
+	u8 y = x1 ^ x2;
+	setNonCarryFlags(state, y);
+	return y;
+}
+
+static inline u8 ALUor(State8080* state, u8 x1, u8 x2) {
+	setFlag(state, FLAG_C, 0);
+	setFlag(state, FLAG_AC, 0);
+	u8 y = x1 | x2;
+	setNonCarryFlags(state, y);
+	return y;
+}
+
+static inline void ALUcmp(State8080* state, u8 x1, u8 x2) {
+	ALUsub(state, x1, x2, 0);
+}
+
+static inline bool evaluateCC(State8080* state, u8 cc) {
+	switch (cc) {
+		case 0:
+			return !getFlag(state, FLAG_Z);
+		case 1:
+			return getFlag(state, FLAG_Z);
+		case 2:
+			return !getFlag(state, FLAG_C);
+		case 3:
+			return getFlag(state, FLAG_C);
+		case 4:
+			return !getFlag(state, FLAG_P);
+		case 5:
+			return getFlag(state, FLAG_P);
+		case 6:
+			return !getFlag(state, FLAG_S);
+		case 7:
+			return getFlag(state, FLAG_S);
+	}
+}
+
+#endif
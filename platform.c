@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -11,28 +12,33 @@
 #include "emulate8080.h"
 #include "machine.h"
 #include "platform.h"
+#include "rom.h"
+#include "debugger.h"
+#include "movie.h"
+#include "capture.h"
+#include "telemetry.h"
+#include "input.h"
+#include "coverage.h"
+#include "publish.h"
 
 #define PIXEL_SIZE_X 2
 #define PIXEL_SIZE_Y 3
 
-#define VRAM_START 0x2400
-
 #define FPS 60
 
-struct timeval tv;
-int64_t currMicro() {
-	gettimeofday(&tv, NULL);
-	return (tv.tv_sec)*1000000 + tv.tv_usec;
-}
-
-struct timespec ts;
-int64_t currNano() {
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return ts.tv_sec * 1000000000L + ts.tv_nsec;
-}
-
 State8080* cpu;
 Machine* machine;
+Debugger* dbg = NULL; // only attached with -d or F12
+Movie* recording = NULL; // -r file
+Movie* playback = NULL; // -p file
+Capture* capture = NULL; // -c file
+Telemetry* telemetry = NULL; // -t file or the overlay
+TelemetryThread* frameTimes = NULL;
+bool overlay = false; // -o or F11
+InputQueue* inputs;
+Coverage* coverage = NULL; // -x or -X file
+Publisher* publisher = NULL; // -P name
+bool running = true;
 
 const int WINDOW_WIDTH = PIXEL_SIZE_X * SCREEN_WIDTH;
 const int WINDOW_HEIGHT = PIXEL_SIZE_Y * SCREEN_HEIGHT;
@@ -41,7 +47,7 @@ Uint32* pixels; // actually displayed screen
 SDL_Window* window;
 SDL_Surface* surface;
 
-void initWindow() {
+void initWindow(const char* title) {
 	printf("%d x %d\n", WINDOW_WIDTH, WINDOW_HEIGHT);
 	window = NULL;
 	surface = NULL;
@@ -50,7 +56,7 @@ void initWindow() {
 		exit(1);
 	}
 	window = SDL_CreateWindow(
-			"SDL Basic",
+			title,
 			SDL_WINDOWPOS_UNDEFINED,
 			SDL_WINDOWPOS_UNDEFINED,
 			WINDOW_WIDTH,
@@ -65,42 +71,143 @@ void initWindow() {
 	pixels = surface->pixels;
 }
 
+#define OVERLAY_HEIGHT 96
+
+// the last TELEMETRY_RECENT frames as bars in the bottom left corner, a pixel of height per
+// 1/(OVERLAY_HEIGHT/2) of a frame: cpu green, converting VRAM yellow, presenting red,
+// with a line at one frame (16.7 ms)
+void drawOverlay() {
+	const int64_t NANOSECONDS_PER_FRAME = 1000000000L / FPS;
+	const Uint32 colors[TM_METRICS] = {0, 0xFF00C000, 0xFFC0C000, 0xFFC00000, 0};
+	int frames = frameTimes->frames < TELEMETRY_RECENT ? frameTimes->frames : TELEMETRY_RECENT;
+	for (int i = 0; i < frames; i++) {
+		const FrameTiming* timing = telemetryRecent(frameTimes, frames - 1 - i);
+		int y = WINDOW_HEIGHT - 1;
+		for (int m = TM_CPU; m <= TM_PRESENT; m++) {
+			int h = timing->values[m] * (OVERLAY_HEIGHT / 2) / NANOSECONDS_PER_FRAME;
+			for (; h > 0 && y >= WINDOW_HEIGHT - OVERLAY_HEIGHT; h--, y--) {
+				for (int l = 0; l < PIXEL_SIZE_X; l++) pixels[y * WINDOW_WIDTH + PIXEL_SIZE_X * i + l] = colors[m];
+			}
+		}
+	}
+	for (int x = 0; x < PIXEL_SIZE_X * TELEMETRY_RECENT; x++) {
+		pixels[(WINDOW_HEIGHT - 1 - OVERLAY_HEIGHT / 2) * WINDOW_WIDTH + x] = 0xFFFFFFFF;
+	}
+}
+
 void cleanWindow() {
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 }
 
-bool loadFile(char* filename, int location) {
-	FILE* f = fopen(filename, "rb");
-	if (f == NULL) {
-		printf("Error loading file: %s\n", filename);
-		exit(1);
+// emulated cycles since power on
+int64_t cpuClock = 0;
+
+// keys go through the input queue to land on a frame boundary
+void pressKey(enum MKey key, bool down) {
+	if (queueKey(inputs, key, down, currNano(), cpuClock)) return;
+	if (down) machineKeyDown(machine, key);
+	else machineKeyUp(machine, key);
+}
+
+// runs the cpu until cpuClock reaches deadline (the next interrupt)
+// ordinary runs stay on the plain loop, breakpoints only cost anything once a debugger is attached
+void runCpu(int64_t deadline) {
+	takeInterruptRequest8080(cpu);
+	if (dbg == NULL) {
+		while (cpuClock < deadline) {
+			cpuClock += nextOp8080(cpu, machine);
+			if (machine->portsRead) inputPortsRead(inputs, machine, cpuClock, currNano());
+			waitForInterrupt8080(cpu, &cpuClock, deadline);
+		}
+		return;
+	}
+	while (cpuClock < deadline && running) {
+		cpuClock += debugRun(dbg, deadline - cpuClock);
+		if (machine->portsRead) inputPortsRead(inputs, machine, cpuClock, currNano());
+		if (dbg->stopped && !debugPrompt(dbg)) {
+			cpu->on = false;
+			running = false;
+		}
 	}
-	int filesize;
-	fseek(f, 0, SEEK_END);
-	filesize = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	fread(cpu->memory + location, 1, filesize, f);
-	fclose(f);
-	return true;
 }
 
-int main() {
-	cpu = initState8080();
-	machine = initMachine();
-	
-	// h,g,f,e at 0x0000, 0x0800, 0x1000, 0x1800
-	// load programs
-	loadFile("roms/invaders.h", 0x0000);
-	loadFile("roms/invaders.g", 0x0800);
-	loadFile("roms/invaders.f", 0x1000);
-	loadFile("roms/invaders.e", 0x1800);
-
-	initWindow();
-	
+int main(int argc, char** argv) {
 	SDL_Event e;
 
-	bool running = true;
+	const Board* board = &boards[0];
+	bool startStopped = false;
+	const char* recordFile = NULL;
+	const char* captureFile = NULL;
+	int captureScale = 1;
+	const char* telemetryFile = NULL;
+	const char* inputLogFile = NULL;
+	const char* coverageFile = NULL;
+	bool coverBranches = false;
+	int frame = 0;
+	int64_t frameStart = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+			recordFile = argv[++i];
+			recording = initMovie();
+		}
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+			playback = loadMovie(argv[++i]);
+			if (playback == NULL) exit(1);
+		}
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc) captureFile = argv[++i];
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) captureScale = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) telemetryFile = argv[++i];
+		else if (!strcmp(argv[i], "-o")) overlay = true;
+		else if (!strcmp(argv[i], "-l") && i + 1 < argc) inputLogFile = argv[++i];
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+			board = findBoard(argv[++i]);
+			if (board == NULL) exit(1);
+		}
+		else if ((!strcmp(argv[i], "-x") || !strcmp(argv[i], "-X")) && i + 1 < argc) {
+			coverBranches = argv[i][1] == 'X';
+			coverageFile = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-P") && i + 1 < argc) {
+			publisher = initPublisher(argv[++i]);
+			if (publisher == NULL) exit(1);
+		}
+		else if (!strcmp(argv[i], "-d")) startStopped = true;
+	}
+
+	cpu = initState8080();
+	machine = initBoardMachine(board);
+	const u8* rom = loadBoardRom(board, "roms");
+	if (rom == NULL) exit(1);
+	machineMapMemory(machine, cpu, rom);
+	// no point burning host time in the game's wait-for-vblank loops
+	cpu->idleSkip = true;
+	if (coverageFile != NULL) {
+		coverage = initCoverage();
+		attachCoverage(cpu, coverage, coverBranches);
+	}
+
+	initWindow(board->title);
+
+	if (startStopped) {
+		// start stopped at the reset vector
+		dbg = initDebugger(cpu, machine);
+		dbg->stopped = true;
+		if (!debugPrompt(dbg)) running = false;
+	}
+
+	// frames the writer can't keep up with are dropped rather than holding up the game
+	if (captureFile != NULL) {
+		capture = initCapture(captureFile, captureFormatFor(captureFile), captureScale, false);
+		if (capture == NULL) exit(1);
+	}
+	inputs = initInputQueue(inputLogFile);
+	if (inputs == NULL) exit(1);
+	if (telemetryFile != NULL || overlay) {
+		telemetry = initTelemetry(telemetryFile, 1000);
+		if (telemetry == NULL) exit(1);
+		frameTimes = telemetryThread(telemetry, "main");
+	}
 
 	const int MICROSECONDS_PER_FRAME = 1000000 / FPS;
 	const int64_t NANOSECONDS_PER_FRAME = 1000000000L / FPS;
@@ -112,6 +219,14 @@ int main() {
 	int64_t cycles = 0;
 	int64_t last = 0;
 
+	// this frame's share of host time, recorded at vblank
+	int64_t cpuNanos = 0;
+	int64_t convertNanos = 0;
+	int64_t presentNanos = 0;
+	int64_t lastVblank = currNano();
+	int64_t lastClock = 0;
+	int64_t t0, t1;
+
 	u8 vRamCopy[SCREEN_WIDTH][SCREEN_HEIGHT/8];
 	memset(vRamCopy, 0, sizeof(vRamCopy));
 
@@ -123,71 +238,90 @@ int main() {
 				running = 0;
 				break;
 			case SDL_KEYDOWN:
+				// held keys auto-repeat, only the first press means anything
+				if (e.key.repeat) break;
 				switch (e.key.keysym.scancode) {
+					case 68:
+						// F11 toggles the frame time overlay
+						if (telemetry == NULL) {
+							telemetry = initTelemetry(NULL, 1000);
+							frameTimes = telemetryThread(telemetry, "main");
+						}
+						overlay = !overlay;
+						break;
+					case 69:
+						// F12 breaks into the debugger
+						if (dbg == NULL) dbg = initDebugger(cpu, machine);
+						if (!debugPrompt(dbg)) {
+							cpu->on = false;
+							running = false;
+						}
+						break;
 					case 225:
-						machineKeyDown(machine, MK_COIN);
+						pressKey(MK_COIN, true);
 						break;
 					case 30:
-						machineKeyDown(machine, MK_1P_START);
+						pressKey(MK_1P_START, true);
 						break;
 					case 31:
-						machineKeyDown(machine, MK_2P_START);
+						pressKey(MK_2P_START, true);
 						break;
 					case 4:
-						machineKeyDown(machine, MK_1P_LEFT);
+						pressKey(MK_1P_LEFT, true);
 						break;
 					case 7:
-						machineKeyDown(machine, MK_1P_RIGHT);
+						pressKey(MK_1P_RIGHT, true);
 						break;
 					case 26:
-						machineKeyDown(machine, MK_1P_SHOT);
+						pressKey(MK_1P_SHOT, true);
 						break;
 					case 80:
-						machineKeyDown(machine, MK_2P_LEFT);
+						pressKey(MK_2P_LEFT, true);
 						break;
 					case 79:
-						machineKeyDown(machine, MK_2P_RIGHT);
+						pressKey(MK_2P_RIGHT, true);
 						break;
 					case 82:
-						machineKeyDown(machine, MK_2P_SHOT);
+						pressKey(MK_2P_SHOT, true);
 						break;
 				}
 				break;
 			case SDL_KEYUP:
 				switch (e.key.keysym.scancode) {
 					case 225:
-						machineKeyUp(machine, MK_COIN);
+						pressKey(MK_COIN, false);
 						break;
 					case 22:
-						machineKeyUp(machine, MK_1P_START);
+						pressKey(MK_1P_START, false);
 						break;
 					case 4:
-						machineKeyUp(machine, MK_1P_LEFT);
+						pressKey(MK_1P_LEFT, false);
 						break;
 					case 7:
-						machineKeyUp(machine, MK_1P_RIGHT);
+						pressKey(MK_1P_RIGHT, false);
 						break;
 					case 26:
-						machineKeyUp(machine, MK_1P_SHOT);
+						pressKey(MK_1P_SHOT, false);
 						break;
 					case 81:
-						machineKeyUp(machine, MK_2P_START);
+						pressKey(MK_2P_START, false);
 						break;
 					case 80:
-						machineKeyUp(machine, MK_2P_LEFT);
+						pressKey(MK_2P_LEFT, false);
 						break;
 					case 79:
-						machineKeyUp(machine, MK_2P_RIGHT);
+						pressKey(MK_2P_RIGHT, false);
 						break;
 					case 82:
-						machineKeyUp(machine, MK_2P_SHOT);
+						pressKey(MK_2P_SHOT, false);
 						break;
 				}
 				break;
 		}
 		
 		if (currMicro() - lastHalf >= MICROSECONDS_PER_FRAME) {
-			memcpy(vRamCopy, cpu->memory + VRAM_START, SCREEN_HEIGHT * SCREEN_WIDTH / 8);
+			t0 = currNano();
+			memcpy(vRamCopy, cpu->memory + board->videoStart, SCREEN_HEIGHT * SCREEN_WIDTH / 8);
 			// rotate
 			Uint32 pixel;
 			for (int i = 0; i < 96; i++) {
@@ -200,15 +334,21 @@ int main() {
 					}
 				}
 			}
+			t1 = currNano();
+			convertNanos += t1 - t0;
 			SDL_UpdateWindowSurface(window);
+			t0 = currNano();
+			presentNanos += t0 - t1;
+			inputPresented(inputs, t0);
 			lastHalf = currMicro(); 
-			VBlankHalfInterrupt(cpu);
-			// lol
-			for (int i = 0; i < 1000; i++) nextOp8080(cpu, machine);
-
+			VBlankHalfInterrupt(machine, cpu);
+			// mid-screen to vblank
+			runCpu(frameStart + CYCLES_PER_FRAME);
+			cpuNanos += currNano() - t0;
 		}
 		if (currMicro() - lastFull >= MICROSECONDS_PER_FRAME) {
-			memcpy(vRamCopy, cpu->memory + VRAM_START, SCREEN_HEIGHT * SCREEN_WIDTH / 8);
+			t0 = currNano();
+			memcpy(vRamCopy, cpu->memory + board->videoStart, SCREEN_HEIGHT * SCREEN_WIDTH / 8);
 			// rotate
 			Uint32 pixel;
 			for (int i = 96; i < SCREEN_WIDTH; i++) {
@@ -221,17 +361,49 @@ int main() {
 					}
 				}
 			}
+			if (overlay) drawOverlay();
+			t1 = currNano();
+			convertNanos += t1 - t0;
 			SDL_UpdateWindowSurface(window);
+			t0 = currNano();
+			presentNanos += t0 - t1;
+			inputPresented(inputs, t0);
 			lastFull = currMicro();
-			VBlankFullInterrupt(cpu);
-			
-			while (cycles < CYCLES_PER_BLOCK) {
-				cycles += nextOp8080(cpu, machine);
+			if (capture != NULL) captureFrame(capture, cpu->memory + board->videoStart, frame);
+			if (publisher != NULL) publishFrame(publisher, cpu, machine, frame, cpuClock);
+			VBlankFullInterrupt(machine, cpu);
+			applyInputs(inputs, machine, cpuClock);
+			if (playback != NULL) playFrame(playback, machine, frame);
+			if (recording != NULL) recordFrame(recording, machine);
+			frame++;
+
+			// vblank to mid-screen of the next frame
+			frameStart += CYCLES_PER_FRAME;
+			runCpu(frameStart + CYCLES_PER_HALF_FRAME);
+			t1 = currNano();
+			cpuNanos += t1 - t0;
+
+			if (frameTimes != NULL) {
+				telemetryRecord(frameTimes, TM_CYCLES, cpuClock - lastClock);
+				telemetryRecord(frameTimes, TM_CPU, cpuNanos);
+				telemetryRecord(frameTimes, TM_CONVERT, convertNanos);
+				telemetryRecord(frameTimes, TM_PRESENT, presentNanos);
+				telemetryRecord(frameTimes, TM_JITTER, t0 - lastVblank - NANOSECONDS_PER_FRAME);
+				telemetryEndFrame(frameTimes);
 			}
-			cycles = 0;
+			cpuNanos = convertNanos = presentNanos = 0;
+			lastVblank = t0;
+			lastClock = cpuClock;
 		}
 	}
 	cleanWindow();
+	if (dbg != NULL) freeDebugger(dbg);
+	if (recording != NULL) saveMovie(recording, recordFile);
+	if (capture != NULL) freeCapture(capture);
+	if (telemetry != NULL) freeTelemetry(telemetry);
+	freeInputQueue(inputs);
+	if (coverage != NULL) saveCoverage(coverage, coverageFile);
+	if (publisher != NULL) freePublisher(publisher);
 	/*
 	// dump memory
 	printf("dumping memory...\n");
@@ -244,5 +416,7 @@ int main() {
 		outputDisassembly();
 		cleanDisassembleFile();
 	}
+	freeState8080(cpu);
+	free(machine);
 	return 0;
 }
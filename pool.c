@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "pool.h"
+
+#define HUGE_PAGE_SZ (2 << 20)
+
+static size_t roundUp(size_t n, size_t to) {
+	return (n + to - 1) / to * to;
+}
+
+// explicit huge pages need reserving (vm.nr_hugepages), so fall back to ordinary pages and
+// let transparent huge pages back them if the kernel will
+static u8* mapArena(InstancePool* pool, size_t size, int flags) {
+	pool->hugePages = false;
+	if (flags & POOL_HUGEPAGES) {
+		size_t huge = roundUp(size, HUGE_PAGE_SZ);
+		void* arena = mmap(NULL, huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (arena != MAP_FAILED) {
+			pool->hugePages = true;
+			pool->arenaSize = huge;
+			return arena;
+		}
+	}
+	void* arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena == MAP_FAILED) return NULL;
+	if (flags & POOL_HUGEPAGES) madvise(arena, size, MADV_HUGEPAGE);
+	pool->arenaSize = size;
+	return arena;
+}
+
+InstancePool* initPool(int size, const Board* board, const u8* rom, const Engine* engine, int flags) {
+	InstancePool* pool = calloc(1, sizeof(InstancePool));
+	pool->size = size;
+	pool->engine = engine;
+	size_t states = roundUp((size_t)size * sizeof(State8080), 64);
+	// the memories have to start on a page
+	size_t memoryStart = roundUp(states + (size_t)size * sizeof(Machine), MEM_ALIGN);
+	size_t arenaSize = memoryStart + (size_t)size * MEM_ALLOC_SZ;
+	pool->arena = mapArena(pool, arenaSize, flags);
+	if (pool->arena == NULL) {
+		printf("Could not map a %zu MB arena for %d instances\n", arenaSize >> 20, size);
+		free(pool);
+		return NULL;
+	}
+
+	pool->instances = malloc(size * sizeof(Instance));
+	State8080* stateArray = (State8080*)pool->arena;
+	Machine* machineArray = (Machine*)(pool->arena + states);
+	for (int i = 0; i < size; i++) {
+		Instance* inst = &pool->instances[i];
+		inst->state = &stateArray[i];
+		inst->machine = &machineArray[i];
+		inst->clock = 0;
+		inst->index = i;
+		inst->next = i + 1 < size ? i + 1 : -1;
+		setupState8080(inst->state, pool->arena + memoryStart + (size_t)i * MEM_ALLOC_SZ);
+		setupMachine(inst->machine, board);
+		machineMapMemory(inst->machine, inst->state, rom);
+		if (!attachEngine(engine, inst->state)) {
+			freePool(pool);
+			return NULL;
+		}
+	}
+	pool->free = size > 0 ? 0 : -1;
+	pool->template = initSnapshot(pool->instances[0].state);
+	saveSnapshot(pool->template, pool->instances[0].state, pool->instances[0].machine, 0);
+	return pool;
+}
+
+void freePool(InstancePool* pool) {
+	munmap(pool->arena, pool->arenaSize);
+	free(pool->instances);
+	free(pool->template);
+	free(pool);
+}
+
+Instance* acquireInstance(InstancePool* pool) {
+	if (pool->free < 0) return NULL;
+	Instance* inst = &pool->instances[pool->free];
+	pool->free = inst->next;
+	pool->inUse++;
+	resetInstance(pool, inst);
+	return inst;
+}
+
+void releaseInstance(InstancePool* pool, Instance* inst) {
+	inst->next = pool->free;
+	pool->free = inst->index;
+	pool->inUse--;
+}
+
+void resetInstance(InstancePool* pool, Instance* inst) {
+	restoreSnapshot(pool->template, inst->state, inst->machine, &inst->clock);
+}
+
+void setPoolTemplate(InstancePool* pool, const Instance* inst) {
+	saveSnapshot(pool->template, inst->state, inst->machine, inst->clock);
+}
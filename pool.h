@@ -0,0 +1,58 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "snapshot.h"
+
+// a fixed number of machines carved out of one arena, for batch drivers that want thousands
+// all the states come first, then all the machines, then all the memories (page aligned), each
+// built once up front with the board mapped and the engine attached
+// taking one out puts it back to the pool's template (power on unless setPoolTemplate says
+// otherwise), which only has to copy the template's RAM and registers
+// acquire and release are O(1) off a free list and don't lock, give each thread its own pool
+#define POOL_HUGEPAGES 1 // try for an arena of explicit huge pages (MAP_HUGETLB), else ask for transparent ones
+
+typedef struct Instance {
+	State8080* state;
+	Machine* machine;
+	int64_t clock;
+	int index;
+	int next; // the next free one while this one is free
+} Instance;
+
+typedef struct InstancePool {
+	int size;
+	int inUse;
+	int free; // index of the first free instance, -1 when they're all taken
+	const Engine* engine;
+	Instance* instances;
+	Snapshot* template;
+	u8* arena;
+	size_t arenaSize;
+	bool hugePages; // explicit huge pages, rather than whatever the kernel gave
+} InstancePool;
+
+// NULL (after printing why) if the arena can't be had or the engine can't run the board
+InstancePool* initPool(int size, const Board* board, const u8* rom, const Engine* engine, int flags);
+void freePool(InstancePool* pool);
+
+// NULL when they're all in use
+Instance* acquireInstance(InstancePool* pool);
+void releaseInstance(InstancePool* pool, Instance* inst);
+// back to the template without giving it up
+void resetInstance(InstancePool* pool, Instance* inst);
+// instances acquired or reset from now on start where inst is now
+void setPoolTemplate(InstancePool* pool, const Instance* inst);
+
+// arena bytes per instance, including its share of the padding
+static inline size_t poolBytesPerInstance(const InstancePool* pool) {
+	return pool->arenaSize / pool->size;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "publish.h"
+
+Publisher* initPublisher(const char* name) {
+	int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0) {
+		printf("Could not create shared memory %s\n", name);
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(PublishRing)) != 0) {
+		printf("Could not size shared memory %s\n", name);
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	PublishRing* ring = mmap(NULL, sizeof(PublishRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		printf("Could not map shared memory %s\n", name);
+		shm_unlink(name);
+		return NULL;
+	}
+	// fresh from ftruncate it's all zeros, so every slot is even (free) and nothing is latest
+	ring->slots = PUBLISH_SLOTS;
+	ring->slotSize = sizeof(PublishedFrame);
+	atomic_thread_fence(memory_order_release);
+	memcpy(ring->magic, PUBLISH_MAGIC, 8);
+
+	Publisher* pub = malloc(sizeof(Publisher));
+	snprintf(pub->name, sizeof(pub->name), "%s", name);
+	pub->ring = ring;
+	return pub;
+}
+
+void publishFrame(Publisher* pub, const State8080* state, const Machine* mach, uint32_t frame, int64_t cycles) {
+	PublishedFrame* slot = &pub->ring->ring[frame % PUBLISH_SLOTS];
+	uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->frame = frame;
+	slot->cycles = cycles;
+	memcpy(slot->regs, state->regs, 8);
+	slot->psw = state->psw;
+	slot->pc = state->pc;
+	slot->sp = state->sp;
+	memcpy(slot->ports, mach->rports, 3);
+	memcpy(slot->vram, state->memory + mach->board->videoStart, VRAM_SZ);
+	atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+	atomic_store_explicit(&pub->ring->latest, frame + 1, memory_order_release);
+}
+
+void freePublisher(Publisher* pub) {
+	munmap(pub->ring, sizeof(PublishRing));
+	shm_unlink(pub->name);
+	free(pub);
+}
+
+const PublishRing* openPublished(const char* name) {
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		printf("No shared memory %s (is the emulator running with -P %s?)\n", name, name);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PublishRing)) {
+		printf("%s is too small to be a frame ring\n", name);
+		close(fd);
+		return NULL;
+	}
+	const PublishRing* ring = mmap(NULL, sizeof(PublishRing), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		printf("Could not map shared memory %s\n", name);
+		return NULL;
+	}
+	if (memcmp(ring->magic, PUBLISH_MAGIC, 8) || ring->slots != PUBLISH_SLOTS || ring->slotSize != sizeof(PublishedFrame)) {
+		printf("%s isn't a frame ring this reader understands\n", name);
+		munmap((void*)ring, sizeof(PublishRing));
+		return NULL;
+	}
+	return ring;
+}
+
+void closePublished(const PublishRing* ring) {
+	munmap((void*)ring, sizeof(PublishRing));
+}
+
+bool readPublished(const PublishRing* ring, uint32_t frame, PublishedFrame* out) {
+	for (;;) {
+		uint32_t seq;
+		const PublishedFrame* slot = beginRead(ring, frame, &seq);
+		if (slot == NULL) {
+			// mid-write to frame itself is worth waiting out, anything else is gone
+			if (!(seq & 1)) return false;
+			continue;
+		}
+		memcpy(out, slot, sizeof(PublishedFrame));
+		if (endRead(slot, seq)) return true;
+	}
+}
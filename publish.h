@@ -0,0 +1,73 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "capture.h"
+
+// every finished frame published to a POSIX shared memory object so other processes can watch
+// the emulator without it knowing or waiting: a ring of slots, each guarded by a seqlock
+// the emulator never blocks, a reader that falls more than PUBLISH_SLOTS frames behind just
+// misses the ones in between, and one that loses a race with the writer sees the slot's
+// sequence change under it and tries again
+#define PUBLISH_MAGIC "8080SHM1"
+#define PUBLISH_SLOTS 8
+
+typedef struct PublishedFrame {
+	_Atomic uint32_t seq; // odd while the emulator is writing the slot
+	uint32_t frame;
+	int64_t cycles; // the cpu clock at the end of the frame
+	u8 regs[8];
+	u8 psw;
+	u16 pc;
+	u16 sp;
+	u8 ports[3]; // read ports 0 to 2, the DIP switches and the inputs
+	u8 vram[VRAM_SZ];
+} PublishedFrame;
+
+typedef struct PublishRing {
+	char magic[8];
+	uint32_t slots;
+	uint32_t slotSize; // sizeof(PublishedFrame), so a reader built differently notices
+	_Atomic uint32_t latest; // the newest complete frame + 1, 0 before the first
+	PublishedFrame ring[PUBLISH_SLOTS]; // frame f goes in ring[f % PUBLISH_SLOTS]
+} PublishRing;
+
+typedef struct Publisher {
+	char name[256];
+	PublishRing* ring;
+} Publisher;
+
+// name is the shared memory object's, "/invaders" say
+// NULL (after printing why) if it can't be created
+Publisher* initPublisher(const char* name);
+// call from the emulator thread once per frame, copies VRAM, registers and ports into the next slot
+void publishFrame(Publisher* pub, const State8080* state, const Machine* mach, uint32_t frame, int64_t cycles);
+// unmaps and removes the object, readers that have it mapped keep the last frames
+void freePublisher(Publisher* pub);
+
+// the reader side, NULL (after printing why) if there's no such object or it isn't a ring
+const PublishRing* openPublished(const char* name);
+void closePublished(const PublishRing* ring);
+
+// zero copy: look at the slot between beginRead and endRead, endRead is false if the emulator
+// wrote to it in the meantime (what was seen is garbage, go again or give up on that frame)
+// beginRead is NULL if the slot no longer (or doesn't yet) hold frame
+static inline const PublishedFrame* beginRead(const PublishRing* ring, uint32_t frame, uint32_t* seq) {
+	const PublishedFrame* slot = &ring->ring[frame % PUBLISH_SLOTS];
+	*seq = atomic_load_explicit((_Atomic uint32_t*)&slot->seq, memory_order_acquire);
+	if ((*seq & 1) || slot->frame != frame) return NULL;
+	return slot;
+}
+static inline bool endRead(const PublishedFrame* slot, uint32_t seq) {
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit((_Atomic uint32_t*)&slot->seq, memory_order_relaxed) == seq;
+}
+// the same copied out, false if frame isn't there any more
+bool readPublished(const PublishRing* ring, uint32_t frame, PublishedFrame* out);
+
+#endif
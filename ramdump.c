@@ -0,0 +1,88 @@
+// reads a RAM stream (headless -R) back
+// with no frame, a summary: how many frames, how much changes a frame and which addresses change most
+// with -f, that frame's work RAM as hex (and the ports), rebuilt from its block's keyframe
+//
+// usage: ./ramdump [-f frame] file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ramstream.h"
+
+static uint32_t changes[RAMSTREAM_SZ];
+
+static int byChanges(const void* a, const void* b) {
+	uint32_t x = changes[*(const int*)a], y = changes[*(const int*)b];
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static const char* portNames[] = {"port 1", "port 2", "shift result", "shift count", "shift low", "shift high"};
+
+static void summary(RamStreamReader* r) {
+	u8 last[RAMSTREAM_SZ], now[RAMSTREAM_SZ];
+	uint64_t total = 0;
+	for (uint32_t f = 0; f < r->frames; f++) {
+		if (!readRamFrame(r, f, now)) return;
+		for (int i = 0; f > 0 && i < RAMSTREAM_SZ; i++) {
+			if (now[i] == last[i]) continue;
+			changes[i]++;
+			total++;
+		}
+		memcpy(last, now, RAMSTREAM_SZ);
+	}
+	printf("%u frames in %u blocks, %.1f changed bytes a frame\n", r->frames, r->blocks, r->frames > 1 ? (double)total / (r->frames - 1) : 0.0);
+	int order[RAMSTREAM_SZ];
+	for (int i = 0; i < RAMSTREAM_SZ; i++) order[i] = i;
+	qsort(order, RAMSTREAM_SZ, sizeof(int), byChanges);
+	printf("most changed:\n");
+	for (int i = 0; i < 16 && changes[order[i]] > 0; i++) {
+		int a = order[i];
+		if (a < RAMSTREAM_RAM_SZ) printf("  %04X  %u frames\n", RAMSTREAM_RAM + a, changes[a]);
+		else printf("  %-12s %u frames\n", portNames[a - RAMSTREAM_RAM_SZ], changes[a]);
+	}
+}
+
+static void dumpFrame(const u8* rec) {
+	for (int i = 0; i < RAMSTREAM_RAM_SZ; i += 16) {
+		printf("%04X ", RAMSTREAM_RAM + i);
+		for (int j = 0; j < 16; j++) printf(" %02X", rec[i+j]);
+		printf("\n");
+	}
+	const u8* ports = rec + RAMSTREAM_RAM_SZ;
+	printf("ports %02X %02X %02X, shift count %d data %02X%02X\n", ports[0], ports[1], ports[2], ports[3], ports[5], ports[4]);
+}
+
+int main(int argc, char** argv) {
+	long frame = -1;
+	const char* name = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && i + 1 < argc) frame = atol(argv[++i]);
+		else if (argv[i][0] != '-') name = argv[i];
+		else {
+			name = NULL;
+			break;
+		}
+	}
+	if (name == NULL) {
+		printf("usage: %s [-f frame] file\n", argv[0]);
+		return 1;
+	}
+	RamStreamReader* r = openRamStream(name);
+	if (r == NULL) return 1;
+	if (frame < 0) summary(r);
+	else {
+		u8 rec[RAMSTREAM_SZ];
+		if (frame >= r->frames) {
+			printf("No frame %ld, there are %u\n", frame, r->frames);
+			closeRamStream(r);
+			return 1;
+		}
+		if (!readRamFrame(r, frame, rec)) {
+			closeRamStream(r);
+			return 1;
+		}
+		dumpFrame(rec);
+	}
+	closeRamStream(r);
+	return 0;
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ramstream.h"
+
+// everything is written in host order, which is little-endian on anything this runs on
+
+static void record(const State8080* state, const Machine* mach, u8 out[RAMSTREAM_SZ]) {
+	memcpy(out, state->memory + RAMSTREAM_RAM, RAMSTREAM_RAM_SZ);
+	u8* ports = out + RAMSTREAM_RAM_SZ;
+	ports[0] = mach->rports[1];
+	ports[1] = mach->rports[2];
+	ports[2] = mach->rports[3];
+	ports[3] = mach->wport2;
+	ports[4] = mach->wport4 & 0xFF;
+	ports[5] = mach->wport4 >> 8;
+}
+
+RamStream* initRamStream(const char* path, int blockFrames) {
+	FILE* out = fopen(path, "wb");
+	if (out == NULL) {
+		printf("Could not write %s\n", path);
+		return NULL;
+	}
+	RamStream* rs = calloc(1, sizeof(RamStream));
+	rs->out = out;
+	rs->blockFrames = blockFrames > 0 ? blockFrames : RAMSTREAM_BLOCK;
+	rs->counts = malloc(rs->blockFrames * sizeof(uint16_t));
+	rs->pairsCap = 4096;
+	rs->addrs = malloc(rs->pairsCap * sizeof(uint16_t));
+	rs->values = malloc(rs->pairsCap);
+	rs->indexCap = 256;
+	rs->index = malloc(rs->indexCap * sizeof(RamStreamBlock));
+	return rs;
+}
+
+static void writeBlock(RamStream* rs) {
+	if (rs->blockLen == 0) return;
+	if (rs->blocks == rs->indexCap) {
+		rs->indexCap *= 2;
+		rs->index = realloc(rs->index, rs->indexCap * sizeof(RamStreamBlock));
+	}
+	rs->index[rs->blocks].firstFrame = rs->blockFirst;
+	rs->index[rs->blocks].offset = ftell(rs->out);
+	rs->blocks++;
+	uint32_t header[3] = {rs->blockFirst, rs->blockLen, rs->pairs};
+	fwrite("RSBK", 1, 4, rs->out);
+	fwrite(header, sizeof(uint32_t), 3, rs->out);
+	fwrite(rs->key, 1, RAMSTREAM_SZ, rs->out);
+	fwrite(rs->counts, sizeof(uint16_t), rs->blockLen, rs->out);
+	fwrite(rs->addrs, sizeof(uint16_t), rs->pairs, rs->out);
+	fwrite(rs->values, 1, rs->pairs, rs->out);
+	rs->blockLen = 0;
+	rs->pairs = 0;
+}
+
+void ramStreamFrame(RamStream* rs, const State8080* state, const Machine* mach) {
+	u8 now[RAMSTREAM_SZ];
+	record(state, mach, now);
+	if (rs->blockLen == rs->blockFrames) writeBlock(rs);
+	if (rs->blockLen == 0) {
+		// a keyframe, what changed since the last block's final frame still counts for the summary
+		if (rs->frames > 0) {
+			for (int i = 0; i < RAMSTREAM_SZ; i++) rs->changes += now[i] != rs->last[i];
+		}
+		memcpy(rs->key, now, RAMSTREAM_SZ);
+		rs->blockFirst = rs->frames;
+		rs->counts[rs->blockLen++] = 0;
+	}
+	else {
+		// room for every byte to have changed
+		if (rs->pairs + RAMSTREAM_SZ > rs->pairsCap) {
+			rs->pairsCap *= 2;
+			rs->addrs = realloc(rs->addrs, rs->pairsCap * sizeof(uint16_t));
+			rs->values = realloc(rs->values, rs->pairsCap);
+		}
+		uint32_t before = rs->pairs;
+		// a word at a time, most of it doesn't change from one frame to the next
+		for (int i = 0; i < RAMSTREAM_SZ; i += 8) {
+			uint64_t a, b;
+			int n = RAMSTREAM_SZ - i < 8 ? RAMSTREAM_SZ - i : 8;
+			a = b = 0;
+			memcpy(&a, now + i, n);
+			memcpy(&b, rs->last + i, n);
+			if (a == b) continue;
+			for (int j = i; j < i + n; j++) {
+				if (now[j] == rs->last[j]) continue;
+				rs->addrs[rs->pairs] = j;
+				rs->values[rs->pairs] = now[j];
+				rs->pairs++;
+			}
+		}
+		rs->counts[rs->blockLen++] = rs->pairs - before;
+		rs->changes += rs->pairs - before;
+	}
+	memcpy(rs->last, now, RAMSTREAM_SZ);
+	rs->frames++;
+}
+
+bool freeRamStream(RamStream* rs) {
+	writeBlock(rs);
+	uint64_t indexOffset = ftell(rs->out);
+	for (uint32_t i = 0; i < rs->blocks; i++) {
+		fwrite(&rs->index[i].firstFrame, sizeof(uint32_t), 1, rs->out);
+		fwrite(&rs->index[i].offset, sizeof(uint64_t), 1, rs->out);
+	}
+	uint32_t footer[3] = {rs->blocks, rs->frames, RAMSTREAM_SZ};
+	fwrite(&indexOffset, sizeof(uint64_t), 1, rs->out);
+	fwrite(footer, sizeof(uint32_t), 3, rs->out);
+	fwrite(RAMSTREAM_MAGIC, 1, 8, rs->out);
+	bool ok = !ferror(rs->out);
+	if (fclose(rs->out) != 0) ok = false;
+	if (rs->frames > 0) {
+		printf("RAM stream: %u frames in %u blocks, %.1f changed bytes a frame, %lld bytes\n", rs->frames, rs->blocks,
+			rs->frames > 1 ? (double)rs->changes / (rs->frames - 1) : 0.0, (long long)indexOffset + rs->blocks * 12 + 28);
+	}
+	free(rs->counts);
+	free(rs->addrs);
+	free(rs->values);
+	free(rs->index);
+	free(rs);
+	return ok;
+}
+
+RamStreamReader* openRamStream(const char* path) {
+	FILE* in = fopen(path, "rb");
+	if (in == NULL) {
+		printf("Error loading file: %s\n", path);
+		return NULL;
+	}
+	uint64_t indexOffset;
+	uint32_t footer[3];
+	char magic[8];
+	if (fseek(in, -28, SEEK_END) != 0 || fread(&indexOffset, sizeof(uint64_t), 1, in) != 1
+			|| fread(footer, sizeof(uint32_t), 3, in) != 3 || fread(magic, 1, 8, in) != 8
+			|| memcmp(magic, RAMSTREAM_MAGIC, 8) || footer[2] != RAMSTREAM_SZ) {
+		printf("%s isn't a RAM stream\n", path);
+		fclose(in);
+		return NULL;
+	}
+	// the index fills the file from indexOffset to the footer, which bounds how many blocks there can be
+	long end = ftell(in) - 28;
+	uint32_t blocks = footer[0], frames = footer[1];
+	if (indexOffset > (uint64_t)end || ((uint64_t)end - indexOffset) / 12 != blocks || ((uint64_t)end - indexOffset) % 12 != 0
+			|| (blocks == 0) != (frames == 0) || fseek(in, indexOffset, SEEK_SET) != 0) {
+		printf("%s has a bad index\n", path);
+		fclose(in);
+		return NULL;
+	}
+	RamStreamReader* r = calloc(1, sizeof(RamStreamReader));
+	r->in = in;
+	r->blocks = blocks;
+	r->frames = frames;
+	r->index = malloc((r->blocks + 1) * sizeof(RamStreamBlock));
+	for (uint32_t i = 0; i < r->blocks; i++) {
+		RamStreamBlock* block = &r->index[i];
+		if (fread(&block->firstFrame, sizeof(uint32_t), 1, in) != 1 || fread(&block->offset, sizeof(uint64_t), 1, in) != 1
+				|| (i > 0 && block->firstFrame <= block[-1].firstFrame)
+				|| (i == 0 && block->firstFrame != 0) || block->firstFrame >= r->frames || block->offset >= indexOffset) {
+			printf("%s has a bad index\n", path);
+			closeRamStream(r);
+			return NULL;
+		}
+	}
+	r->cached = -1;
+	return r;
+}
+
+// frames from block b's first up to the next block's, or the end
+static uint32_t blockSpan(const RamStreamReader* r, int32_t b) {
+	uint32_t next = (uint32_t)b + 1 < r->blocks ? r->index[b+1].firstFrame : r->frames;
+	return next - r->index[b].firstFrame;
+}
+
+static bool loadBlock(RamStreamReader* r, int32_t b) {
+	if (r->cached == b) return true;
+	r->cached = -1;
+	char tag[4];
+	uint32_t header[3];
+	if (fseek(r->in, r->index[b].offset, SEEK_SET) != 0 || fread(tag, 1, 4, r->in) != 4 || memcmp(tag, "RSBK", 4)
+			|| fread(header, sizeof(uint32_t), 3, r->in) != 3) return false;
+	uint32_t frames = header[1], pairs = header[2];
+	// nothing below may index past the arrays or the record, whatever the file says
+	if (header[0] != r->index[b].firstFrame || frames < 1 || frames != blockSpan(r, b)
+			|| pairs > (uint64_t)(frames - 1) * RAMSTREAM_SZ) return false;
+	if (frames > r->framesCap) {
+		r->framesCap = frames;
+		r->counts = realloc(r->counts, frames * sizeof(uint16_t));
+	}
+	if (pairs > r->pairsCap) {
+		r->pairsCap = pairs;
+		r->addrs = realloc(r->addrs, pairs * sizeof(uint16_t));
+		r->values = realloc(r->values, pairs);
+	}
+	if (fread(r->key, 1, RAMSTREAM_SZ, r->in) != RAMSTREAM_SZ
+			|| fread(r->counts, sizeof(uint16_t), frames, r->in) != frames
+			|| fread(r->addrs, sizeof(uint16_t), pairs, r->in) != pairs
+			|| fread(r->values, 1, pairs, r->in) != pairs) return false;
+	uint64_t sum = 0;
+	for (uint32_t f = 0; f < frames; f++) sum += r->counts[f];
+	if (r->counts[0] != 0 || sum != pairs) return false;
+	for (uint32_t p = 0; p < pairs; p++) {
+		if (r->addrs[p] >= RAMSTREAM_SZ) return false;
+	}
+	r->cached = b;
+	r->cachedFrames = frames;
+	r->cachedPairs = pairs;
+	return true;
+}
+
+bool readRamFrame(RamStreamReader* r, uint32_t frame, u8 out[RAMSTREAM_SZ]) {
+	if (frame >= r->frames) return false;
+	// the last block starting at or before frame
+	int32_t lo = 0, hi = r->blocks - 1;
+	while (lo < hi) {
+		int32_t mid = (lo + hi + 1) / 2;
+		if (r->index[mid].firstFrame <= frame) lo = mid;
+		else hi = mid - 1;
+	}
+	if (!loadBlock(r, lo)) {
+		printf("Bad RAM stream block %d\n", lo);
+		return false;
+	}
+	memcpy(out, r->key, RAMSTREAM_SZ);
+	uint32_t p = 0;
+	for (uint32_t f = 1; f <= frame - r->index[lo].firstFrame && f < r->cachedFrames; f++) {
+		for (uint32_t end = p + r->counts[f]; p < end; p++) out[r->addrs[p]] = r->values[p];
+	}
+	return true;
+}
+
+void closeRamStream(RamStreamReader* r) {
+	fclose(r->in);
+	free(r->index);
+	free(r->counts);
+	free(r->addrs);
+	free(r->values);
+	free(r);
+}
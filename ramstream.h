@@ -0,0 +1,85 @@
+#ifndef RAMSTREAM_H
+#define RAMSTREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// how the game's work RAM evolves, a record per frame of the 1 KB at [0x2000, 0x2400) plus the
+// ports, written as only what changed since the frame before
+// a record is RAMSTREAM_SZ bytes: the work RAM, then read ports 1 to 3, wport2 and wport4 (low, high)
+//
+// on disk it's blocks of up to blockFrames frames, each one column after another:
+//   header: "RSBK", first frame, frames, pairs (u32 each)
+//   the block's first frame in full (RAMSTREAM_SZ bytes)
+//   pair counts per frame (u16 each, the first one 0)
+//   offsets into the record of every change (u16 each), then their new values (u8 each)
+// and then an index of every block's first frame and file offset, and a footer:
+//   index offset (u64), blocks, frames, RAMSTREAM_SZ (u32 each), "8080RAM1"
+// so a frame is one binary search of the index and at most blockFrames - 1 deltas from its block's
+// keyframe
+#define RAMSTREAM_RAM 0x2000
+#define RAMSTREAM_RAM_SZ 0x400
+#define RAMSTREAM_SZ (RAMSTREAM_RAM_SZ + 6)
+#define RAMSTREAM_MAGIC "8080RAM1"
+#define RAMSTREAM_BLOCK 256 // frames per block unless asked otherwise
+
+typedef struct RamStreamBlock {
+	uint32_t firstFrame;
+	uint64_t offset;
+} RamStreamBlock;
+
+typedef struct RamStream {
+	FILE* out;
+	uint32_t blockFrames;
+	uint32_t frames;
+	u8 last[RAMSTREAM_SZ];
+	// the block being built, written out when it's full
+	u8 key[RAMSTREAM_SZ];
+	uint32_t blockFirst;
+	uint32_t blockLen;
+	uint16_t* counts;
+	uint16_t* addrs;
+	u8* values;
+	uint32_t pairs;
+	uint32_t pairsCap;
+	RamStreamBlock* index;
+	uint32_t blocks;
+	uint32_t indexCap;
+	uint64_t changes; // bytes changed from one frame to the next over the whole stream, for the summary
+} RamStream;
+
+// NULL (after printing why) if path can't be written, blockFrames 0 for RAMSTREAM_BLOCK
+RamStream* initRamStream(const char* path, int blockFrames);
+// call once a frame, at vblank
+void ramStreamFrame(RamStream* rs, const State8080* state, const Machine* mach);
+// writes the last block and the index, false if anything failed to write
+bool freeRamStream(RamStream* rs);
+
+typedef struct RamStreamReader {
+	FILE* in;
+	uint32_t frames;
+	uint32_t blocks;
+	RamStreamBlock* index;
+	// the block last read, frames from the same block don't go back to the file
+	int32_t cached;
+	uint32_t cachedFrames;
+	uint32_t cachedPairs;
+	u8 key[RAMSTREAM_SZ];
+	uint16_t* counts;
+	uint16_t* addrs;
+	u8* values;
+	uint32_t pairsCap;
+	uint32_t framesCap;
+} RamStreamReader;
+
+// NULL (after printing why) if it can't be read or isn't a RAM stream
+RamStreamReader* openRamStream(const char* path);
+// the whole record for frame into out, false if there's no such frame
+bool readRamFrame(RamStreamReader* r, uint32_t frame, u8 out[RAMSTREAM_SZ]);
+void closeRamStream(RamStreamReader* r);
+
+#endif
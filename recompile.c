@@ -0,0 +1,330 @@
+// translates the ROM ahead of time into C for the "aot" engine (see aot.h)
+// control flow is recovered from reset and the two interrupt vectors, every basic block
+// becomes a labelled run of straight C inside one function, and direct jumps, calls and
+// RSTs become gotos between them. RET, PCHL and anything outside the recovered code go
+// back through a switch on PC, and PCs that aren't block starts get the interpreter.
+//
+// usage: ./recompile [-o out.c] [rom path]
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulate8080.h"
+#include "disassemble.h"
+#include "cfg.h"
+#include "rom.h"
+
+static const char* regNames[8] = {"REG_B", "REG_C", "REG_D", "REG_E", "REG_H", "REG_L", "REG_M", "REG_A"};
+
+static const u8* code;
+static Cfg* cfg;
+static FILE* out;
+
+static bool hasLabel(u16 addr) {
+	return addr < cfg->size && (cfg->flags[addr] & CFG_LEADER) && (cfg->flags[addr] & CFG_CODE);
+}
+
+static void emitJump(u16 target) {
+	if (hasLabel(target)) fprintf(out, "goto L%04X;", target);
+	else fprintf(out, "state->pc = 0x%04X; goto dispatch;", target);
+}
+
+// rare or fiddly instructions just go through the interpreter's own handler
+static void emitFallback(u16 pc, u8 op, u8 d1, u8 d2) {
+	fprintf(out, "\tstate->pc = 0x%04X;\n", (u16)(pc + 1));
+	fprintf(out, "\tused += emulateOp8080(state, machine, 0x%02X, 0x%02X, 0x%02X) - %d;\n", op, d1, d2, opCycles[op]);
+}
+
+// same semantics (and the same helpers) as the matching case in emulateOp8080
+// with the opcode fields, operands and the next PC as constants
+// used already has opCycles[op] added
+static void emitOp(u16 pc) {
+	u8 op = code[pc];
+	u8 d1 = pc + 1 < cfg->size ? code[pc+1] : 0;
+	u8 d2 = pc + 2 < cfg->size ? code[pc+2] : 0;
+	u16 next = pc + opSize8080(op);
+	u16 addr = d1 | (u16)d2 << 8;
+	u8 reg1 = op >> 3 & 7, reg2 = op & 7, rp = op >> 4 & 3, f2 = op >> 6 & 3, l4 = op & 0xF;
+	int extra = opCyclesTaken[op] - opCycles[op];
+
+	switch (op) {
+		case 0x00: case 0x08: case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+			return;
+		case 0xC3: case 0xCB:
+			fprintf(out, "\t"); emitJump(addr); fprintf(out, "\n");
+			return;
+		case 0xC9: case 0xD9:
+			fprintf(out, "\tstate->pc = pop16(state); goto dispatch;\n");
+			return;
+		case 0xCD: case 0xDD: case 0xED: case 0xFD:
+			fprintf(out, "\tpush16(state, 0x%04X); ", next); emitJump(addr); fprintf(out, "\n");
+			return;
+		case 0x07:
+			fprintf(out, "\t{ u8 a7 = state->regs[REG_A]>>7 & 1; setFlag(state, FLAG_C, a7); state->regs[REG_A] = (state->regs[REG_A] << 1) | a7; }\n");
+			return;
+		case 0x0F:
+			fprintf(out, "\t{ u8 a0 = state->regs[REG_A] & 1; setFlag(state, FLAG_C, a0); state->regs[REG_A] = (state->regs[REG_A] >> 1) | (a0<<7); }\n");
+			return;
+		case 0x17:
+			fprintf(out, "\t{ u8 cry = getFlag(state, FLAG_C); setFlag(state, FLAG_C, state->regs[REG_A]>>7 & 1); state->regs[REG_A] = (state->regs[REG_A] << 1) | cry; }\n");
+			return;
+		case 0x1F:
+			fprintf(out, "\t{ u8 cry = getFlag(state, FLAG_C); setFlag(state, FLAG_C, state->regs[REG_A] & 1); state->regs[REG_A] = (state->regs[REG_A] >> 1) | (cry << 7); }\n");
+			return;
+		case 0x22:
+			fprintf(out, "\twriteMem(state, 0x%04X, state->regs[REG_L]); writeMem(state, 0x%04X, state->regs[REG_H]);\n", addr, (u16)(addr + 1));
+			return;
+		case 0x2A:
+			fprintf(out, "\tstate->regs[REG_L] = readMem(state, 0x%04X); state->regs[REG_H] = readMem(state, 0x%04X);\n", addr, (u16)(addr + 1));
+			return;
+		case 0x2F:
+			fprintf(out, "\tstate->regs[REG_A] = ~state->regs[REG_A];\n");
+			return;
+		case 0x32:
+			fprintf(out, "\twriteMem(state, 0x%04X, state->regs[REG_A]);\n", addr);
+			return;
+		case 0x37:
+			fprintf(out, "\tsetFlag(state, FLAG_C, 1);\n");
+			return;
+		case 0x3A:
+			fprintf(out, "\tstate->regs[REG_A] = readMem(state, 0x%04X);\n", addr);
+			return;
+		case 0x3F:
+			fprintf(out, "\tsetFlag(state, FLAG_C, !getFlag(state, FLAG_C));\n");
+			return;
+		case 0x76:
+			fprintf(out, "\tstate->halted = true; state->pc = 0x%04X; return used;\n", next);
+			return;
+		case 0xD3:
+			fprintf(out, "\twritePort(machine, 0x%02X, state->regs[REG_A]);\n", d1);
+			return;
+		case 0xDB:
+			fprintf(out, "\tstate->regs[REG_A] = readPort(machine, 0x%02X);\n", d1);
+			return;
+		case 0xE9:
+			fprintf(out, "\tstate->pc = combine8(state->regs[REG_L], state->regs[REG_H]); goto dispatch;\n");
+			return;
+		case 0xEB:
+			fprintf(out, "\t{ u8 h = state->regs[REG_H], l = state->regs[REG_L]; state->regs[REG_H] = state->regs[REG_D]; state->regs[REG_L] = state->regs[REG_E]; state->regs[REG_D] = h; state->regs[REG_E] = l; }\n");
+			return;
+		case 0xF3:
+			fprintf(out, "\tdisableInterrupts8080(state);\n");
+			return;
+		case 0xF9:
+			fprintf(out, "\tstate->sp = combine8(state->regs[REG_L], state->regs[REG_H]);\n");
+			return;
+		case 0xFB:
+			// the next instruction goes through nextOp8080, which runs it before taking anything pending
+			fprintf(out, "\tenableInterrupts8080(state); state->pc = 0x%04X; goto interp;\n", next);
+			return;
+		case 0x27: // DAA
+		case 0xE3: // XTHL
+			emitFallback(pc, op, d1, d2);
+			return;
+	}
+	if (f2 == 0) {
+		switch (l4) {
+			case 0x1:
+				fprintf(out, "\t*dRegLo(state, %d, false) = 0x%02X; *dRegHi(state, %d, false) = 0x%02X;\n", rp, d1, rp, d2);
+				return;
+			case 0x2:
+				fprintf(out, "\twriteMem(state, combine8(*dRegLo(state, %d, false), *dRegHi(state, %d, false)), state->regs[REG_A]);\n", rp, rp);
+				return;
+			case 0x3:
+				fprintf(out, "\tif (++(*dRegLo(state, %d, false)) == 0) (*dRegHi(state, %d, false))++;\n", rp, rp);
+				return;
+			case 0x9:
+				fprintf(out, "\t{ unsigned int ans = (unsigned int)combine8(state->regs[REG_L], state->regs[REG_H]) + combine8(*dRegLo(state, %d, false), *dRegHi(state, %d, false));\n", rp, rp);
+				fprintf(out, "\t  setFlag(state, FLAG_C, ans >= (1<<16)); state->regs[REG_L] = ans & 0xFF; state->regs[REG_H] = ans>>8 & 0xFF; }\n");
+				return;
+			case 0xA:
+				fprintf(out, "\tstate->regs[REG_A] = readMem(state, combine8(*dRegLo(state, %d, false), *dRegHi(state, %d, false)));\n", rp, rp);
+				return;
+			case 0xB:
+				fprintf(out, "\tif (--(*dRegLo(state, %d, false)) == 0xFF) --(*dRegHi(state, %d, false));\n", rp, rp);
+				return;
+		}
+		switch (reg2) {
+			case 0x4:
+				fprintf(out, "\t{ u8 x = readReg(state, %s); u8 y = x + 1; setNonCarryFlags(state, y); setFlag(state, FLAG_AC, (x & 0xF) == 0xF); writeReg(state, %s, y); }\n",
+						regNames[reg1], regNames[reg1]);
+				return;
+			case 0x5:
+				fprintf(out, "\t{ u8 x = readReg(state, %s); u8 y = x - 1; setFlag(state, FLAG_AC, (x & 0xF) == 0); setNonCarryFlags(state, y); writeReg(state, %s, y); }\n",
+						regNames[reg1], regNames[reg1]);
+				return;
+			case 0x6:
+				fprintf(out, "\twriteReg(state, %s, 0x%02X);\n", regNames[reg1], d1);
+				return;
+		}
+	}
+	if (f2 == 1) {
+		fprintf(out, "\twriteReg(state, %s, readReg(state, %s));\n", regNames[reg1], regNames[reg2]);
+		return;
+	}
+	if (f2 == 3) {
+		switch (l4) {
+			case 0x1:
+				fprintf(out, "\t*dRegLo(state, %d, true) = pop8(state); *dRegHi(state, %d, true) = pop8(state);\n", rp, rp);
+				if (rp == 3) fprintf(out, "\tstate->psw = (state->psw & ~0x28) | 2;\n");
+				return;
+			case 0x5:
+				fprintf(out, "\tpush8(state, *dRegHi(state, %d, true)); push8(state, *dRegLo(state, %d, true));\n", rp, rp);
+				return;
+		}
+		switch (reg2) {
+			case 0:
+				fprintf(out, "\tif (evaluateCC(state, %d)) { used += %d; state->pc = pop16(state); goto dispatch; }\n", reg1, extra);
+				return;
+			case 2:
+				fprintf(out, "\tif (evaluateCC(state, %d)) { ", reg1); emitJump(addr); fprintf(out, " }\n");
+				return;
+			case 4:
+				fprintf(out, "\tif (evaluateCC(state, %d)) { used += %d; push16(state, 0x%04X); ", reg1, extra, next);
+				emitJump(addr);
+				fprintf(out, " }\n");
+				return;
+			case 7:
+				fprintf(out, "\tpush16(state, 0x%04X); ", next); emitJump(8*reg1); fprintf(out, "\n");
+				return;
+		}
+	}
+	// ALU with a register (f2 == 2) or immediate (f2 == 3, reg2 == 6)
+	if (f2 == 2 || (f2 == 3 && reg2 == 6)) {
+		char operand[32];
+		if (f2 == 2) snprintf(operand, sizeof(operand), "readReg(state, %s)", regNames[reg2]);
+		else snprintf(operand, sizeof(operand), "0x%02X", d1);
+		const char* a = "readReg(state, REG_A)";
+		switch (reg1) {
+			case 0: fprintf(out, "\twriteReg(state, REG_A, ALUadd(state, %s, %s, 0));\n", a, operand); return;
+			case 1: fprintf(out, "\twriteReg(state, REG_A, ALUadd(state, %s, %s, getFlag(state, FLAG_C)));\n", a, operand); return;
+			case 2: fprintf(out, "\twriteReg(state, REG_A, ALUsub(state, %s, %s, 0));\n", a, operand); return;
+			case 3: fprintf(out, "\twriteReg(state, REG_A, ALUsub(state, %s, %s, getFlag(state, FLAG_C)));\n", a, operand); return;
+			case 4: fprintf(out, "\twriteReg(state, REG_A, ALUand(state, %s, %s, %s));\n", a, operand, f2 == 2 ? "true" : "false"); return;
+			case 5: fprintf(out, "\twriteReg(state, REG_A, ALUxor(state, %s, %s));\n", a, operand); return;
+			case 6: fprintf(out, "\twriteReg(state, REG_A, ALUor(state, %s, %s));\n", a, operand); return;
+			case 7: fprintf(out, "\tALUcmp(state, %s, %s);\n", a, operand); return;
+		}
+	}
+	emitFallback(pc, op, d1, d2);
+}
+
+// the next instruction start after pc in address order (instructions can overlap)
+static int nextCode(int pc) {
+	for (pc++; pc < cfg->size; pc++) {
+		if (cfg->flags[pc] & CFG_CODE) return pc;
+	}
+	return -1;
+}
+
+// most cycles a block can take, which is how much budget it needs left to run without checks
+static int blockCycles(u16 leader) {
+	int cycles = 0;
+	u16 pc = leader;
+	while (true) {
+		u8 op = code[pc];
+		cycles += opCyclesTaken[op];
+		enum FlowKind kind = flowKind8080(op);
+		u16 next = pc + opSize8080(op);
+		if (kind != FLOW_NEXT || next >= cfg->size || !(cfg->flags[next] & CFG_CODE) || (cfg->flags[next] & CFG_LEADER)) break;
+		pc = next;
+	}
+	return cycles;
+}
+
+static void emitComment(u16 pc) {
+	char buffer[64], clean[64];
+	disassemble8080(buffer, code[pc], pc + 1 < cfg->size ? code[pc+1] : 0, pc + 2 < cfg->size ? code[pc+2] : 0, pc);
+	// squash the tab alignment down to single spaces
+	int n = 0;
+	for (char* p = buffer; *p && n < (int)sizeof(clean) - 1; p++) {
+		if (*p == '\t' || *p == ' ') {
+			if (n > 0 && clean[n-1] != ' ') clean[n++] = ' ';
+		}
+		else clean[n++] = *p;
+	}
+	while (n > 0 && clean[n-1] == ' ') n--;
+	clean[n] = '\0';
+	fprintf(out, "\t// %s\n", clean);
+}
+
+static void emitProgram(uint32_t crc) {
+	fprintf(out, "// generated by recompile, don't edit\n");
+	fprintf(out, "// %d instructions in %d blocks, %d PCHLs\n\n", cfg->instructions, cfg->blocks, cfg->indirect);
+	fprintf(out, "#include <stdbool.h>\n\n");
+	fprintf(out, "#include \"aot.h\"\n#include \"emulate8080.h\"\n#include \"machine.h\"\n#include \"ops8080.h\"\n\n");
+	fprintf(out, "const uint32_t aotRomCrc = 0x%08x;\n\n", crc);
+	fprintf(out, "int aotRun(State8080* state, Machine* machine, int budget) {\n");
+	fprintf(out, "\tint used = 0;\n");
+	fprintf(out, "\tif (state->interrupted || state->halted) {\n");
+	fprintf(out, "\t\tused += nextOp8080(state, machine);\n");
+	fprintf(out, "\t\tif (state->halted) return used;\n");
+	fprintf(out, "\t}\n");
+	fprintf(out, "dispatch:\n");
+	fprintf(out, "\tif (used >= budget) return used;\n");
+	fprintf(out, "\tif (state->interrupted) goto interp;\n");
+	fprintf(out, "\tswitch (state->pc) {\n");
+	for (int pc = 0; pc < cfg->size; pc++) {
+		if (hasLabel(pc)) fprintf(out, "\t\tcase 0x%04X: goto L%04X;\n", pc, pc);
+	}
+	fprintf(out, "\t}\n");
+	// a block guard can land here with the budget already used up (falling or jumping into it)
+	fprintf(out, "interp:\n");
+	fprintf(out, "\tif (used >= budget) return used;\n");
+	fprintf(out, "\tused += nextOp8080(state, machine);\n");
+	fprintf(out, "\tif (state->halted) return used;\n");
+	fprintf(out, "\tgoto dispatch;\n");
+
+	for (int pc = nextCode(-1); pc >= 0; pc = nextCode(pc)) {
+		u8 op = code[pc];
+		if (hasLabel(pc)) {
+			fprintf(out, "\nL%04X:\n", pc);
+			fprintf(out, "\tif (budget - used < %d) { state->pc = 0x%04X; goto interp; }\n", blockCycles(pc), pc);
+		}
+		emitComment(pc);
+		fprintf(out, "\tused += %d;\n", opCycles[op]);
+		emitOp(pc);
+		// carry on into the next instruction, unless it isn't the one laid out next
+		enum FlowKind kind = flowKind8080(op);
+		if (kind == FLOW_JUMP || kind == FLOW_RET || kind == FLOW_INDIRECT || kind == FLOW_HALT) continue;
+		u16 next = pc + opSize8080(op);
+		if (nextCode(pc) != next) {
+			fprintf(out, "\t"); emitJump(next); fprintf(out, "\n");
+		}
+	}
+	fprintf(out, "}\n");
+}
+
+int main(int argc, char** argv) {
+	const char* outName = "aot_invaders.c";
+	const char* romPath = "roms";
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) outName = argv[++i];
+		else if (argv[i][0] != '-') romPath = argv[i];
+		else {
+			printf("usage: %s [-o out.c] [rom path]\n", argv[0]);
+			return 1;
+		}
+	}
+	code = loadRom(romPath);
+	if (code == NULL) return 1;
+
+	cfg = initCfg(code, ROM_SZ);
+	// reset, and the RST 1 / RST 2 the machine raises mid-screen and at vblank
+	addCfgEntry(cfg, 0x0000);
+	addCfgEntry(cfg, 0x0008);
+	addCfgEntry(cfg, 0x0010);
+
+	out = fopen(outName, "w");
+	if (out == NULL) {
+		printf("Could not write %s\n", outName);
+		return 1;
+	}
+	emitProgram(romCrc32(code, ROM_SZ));
+	fclose(out);
+	printf("%s: %d instructions in %d blocks, %d PCHLs left to the interpreter\n",
+			outName, cfg->instructions, cfg->blocks, cfg->indirect);
+	freeCfg(cfg);
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rom.h"
+
+static pthread_mutex_t romLock = PTHREAD_MUTEX_INITIALIZER;
+// one per entry in boards
+#define MAX_BOARDS 16
+static u8* romImages[MAX_BOARDS];
+
+uint32_t romCrc32(const u8* data, int len) {
+	uint32_t crc = 0xFFFFFFFF;
+	for (int i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int j = 0; j < 8; j++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+// maps a file read-only, checking it is exactly size bytes
+static u8* mapFile(const char* filename, int size) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		printf("Error loading file: %s\n", filename);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size != size) {
+		printf("Bad ROM size for %s: expected %d bytes\n", filename, size);
+		close(fd);
+		return NULL;
+	}
+	// MAP_SHARED so other processes mapping the same file share the page cache pages
+	u8* p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		printf("Could not map %s\n", filename);
+		return NULL;
+	}
+	return p;
+}
+
+static bool checkParts(const Board* board, const char* path, const u8* image) {
+	for (const RomPart* part = board->roms; part < board->roms + BOARD_MAX_ROMS && part->name != NULL; part++) {
+		if (part->crc == 0) continue;
+		uint32_t crc = romCrc32(image + part->addr, part->size);
+		if (crc != part->crc) {
+			printf("Bad checksum for %s (%s): %08X, expected %08X\n", part->name, path, crc, part->crc);
+			return false;
+		}
+	}
+	return true;
+}
+
+static u8* loadCombined(const Board* board, const char* path) {
+	u8* image = mapFile(path, board->romSize);
+	if (image == NULL) return NULL;
+	if (!checkParts(board, path, image)) {
+		munmap(image, board->romSize);
+		return NULL;
+	}
+	return image;
+}
+
+static u8* loadParts(const Board* board, const char* dir) {
+	u8* image = mmap(NULL, board->romSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (image == MAP_FAILED) return NULL;
+	char filename[4096];
+	for (const RomPart* part = board->roms; part < board->roms + BOARD_MAX_ROMS && part->name != NULL; part++) {
+		snprintf(filename, sizeof(filename), "%s/%s", dir, part->name);
+		u8* data = mapFile(filename, part->size);
+		if (data == NULL) {
+			munmap(image, board->romSize);
+			return NULL;
+		}
+		memcpy(image + part->addr, data, part->size);
+		munmap(data, part->size);
+	}
+	if (!checkParts(board, dir, image)) {
+		munmap(image, board->romSize);
+		return NULL;
+	}
+	// nobody gets to write the ROM from here on
+	mprotect(image, board->romSize, PROT_READ);
+	return image;
+}
+
+const u8* loadBoardRom(const Board* board, const char* path) {
+	int b = board - boards;
+	pthread_mutex_lock(&romLock);
+	if (romImages[b] == NULL) {
+		struct stat st;
+		if (stat(path, &st) < 0) printf("Error loading file: %s\n", path);
+		else if (S_ISDIR(st.st_mode)) romImages[b] = loadParts(board, path);
+		else romImages[b] = loadCombined(board, path);
+	}
+	pthread_mutex_unlock(&romLock);
+	return romImages[b];
+}
+
+const u8* loadRom(const char* path) {
+	return loadBoardRom(&boards[0], path);
+}
+
+void unloadRom() {
+	pthread_mutex_lock(&romLock);
+	for (int b = 0; b < numBoards; b++) {
+		if (romImages[b] != NULL) munmap(romImages[b], boards[b].romSize);
+		romImages[b] = NULL;
+	}
+	pthread_mutex_unlock(&romLock);
+}
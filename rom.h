@@ -0,0 +1,27 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "board.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+// the main program lives in 8 KB of ROM at [0x0000, 0x2000) on every board
+// (four 2 KB chips at 0x0000, 0x0800, 0x1000, 0x1800), some boards have more at 0x4000
+#define ROM_SZ 0x2000
+
+// path is either a directory holding the board's ROM parts or a single image of board->romSize bytes
+// the image is mapped once per process (per board) and shared read-only by every instance,
+// later calls just hand back the same pointer
+// returns NULL (after printing why) if a file is missing, the wrong size or fails its checksum
+const u8* loadBoardRom(const Board* board, const char* path);
+// Space Invaders
+const u8* loadRom(const char* path);
+void unloadRom();
+
+uint32_t romCrc32(const u8* data, int len);
+
+#endif
@@ -0,0 +1,402 @@
+// beam search for high-score play: from the start of a game, tries every held input (nothing,
+// left, right, fire, left + fire, right + fire) for a few frames from each of the best positions so
+// far, scores where each one ended up from RAM (the score, and staying alive) and keeps the best
+// of those for the next step
+// a position any thread already reached (on this step or an earlier one) isn't kept twice, by its
+// state hash in a transposition table shared by all the threads
+// the children of a step are spread over a thread per core, each with a queue of them that the
+// others steal half of when they run out
+// writes the best line found as a movie (from power on, so headless/platform -p replay it)
+//
+// usage: ./search [-e engine] [-j threads] [-w width] [-n frames] [-d steps] [-m movie] [-o best.mov] [-S]
+//   -w  positions kept each step (default 64)
+//   -n  frames each input is held for (default 8)
+//   -d  steps to search (default 200)
+//   -m  where to start, played from power on (default: insert a coin, press 1P start, wait for the game)
+//   -S  run a short search on 1, 2, 4... up to -j threads and print how it scales
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+#include "engine.h"
+#include "movie.h"
+#include "snapshot.h"
+#include "pool.h"
+#include "gamestate.h"
+#include "transtable.h"
+#include "rom.h"
+#include "platform.h"
+
+#define ACTIONS 6
+#define DEAD_SCORE (-(1 << 30))
+
+static const u8 actions[ACTIONS] = {0x00, 0x20, 0x40, 0x10, 0x30, 0x50}; // port 1: left 0x20, right 0x40, fire 0x10
+
+typedef struct Child {
+	Snapshot* snap;
+	int parent;
+	int action;
+	int64_t score;
+	u8 aliensLeft;
+	uint64_t tie; // random each step, so positions that score the same aren't kept in index order
+	bool over;
+	bool seen; // some other child got to the same state first
+} Child;
+
+// a range of child indexes, the next one in the low half and the end in the high half so the
+// owner taking one from the front and a thief taking half off the back are both one CAS
+typedef struct Worker {
+	_Alignas(64) _Atomic uint64_t range;
+	Instance* inst;
+	InstancePool* pool;
+	uint64_t rng;
+	pthread_t thread;
+	int64_t nodes;
+} Worker;
+
+static const Engine* engine;
+static const u8* rom;
+static int numWorkers;
+static Worker* workers;
+static pthread_barrier_t startLevel, endLevel;
+static _Atomic bool quit;
+static int frames = 8;
+// the step being expanded
+static Snapshot** beam;
+static int beamSize;
+static Child* children;
+static TransTable* explored;
+
+static uint64_t packRange(uint32_t lo, uint32_t hi) {
+	return (uint64_t)hi << 32 | lo;
+}
+
+static bool takeTask(Worker* w, uint32_t* task) {
+	uint64_t r = atomic_load_explicit(&w->range, memory_order_acquire);
+	for (;;) {
+		uint32_t lo = r, hi = r >> 32;
+		if (lo >= hi) return false;
+		if (atomic_compare_exchange_weak(&w->range, &r, packRange(lo + 1, hi))) {
+			*task = lo;
+			return true;
+		}
+	}
+}
+
+// the back half of victim's range becomes thief's (thief's own is empty, so nobody else can
+// be taking from it)
+static bool steal(Worker* thief, Worker* victim) {
+	uint64_t r = atomic_load_explicit(&victim->range, memory_order_acquire);
+	for (;;) {
+		uint32_t lo = r, hi = r >> 32;
+		if (lo >= hi) return false;
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (atomic_compare_exchange_weak(&victim->range, &r, packRange(lo, mid))) {
+			atomic_store_explicit(&thief->range, packRange(mid, hi), memory_order_release);
+			return true;
+		}
+	}
+}
+
+static int64_t scoreOf(const GameState* g) {
+	if (!g->playing) return DEAD_SCORE;
+	// a ship is worth more than anything a few frames of shooting can get
+	return g->scores[0] + 1000 * (int64_t)g->ships[0] - (g->playerAlive ? 0 : 500);
+}
+
+static void expand(Worker* w, uint32_t task) {
+	Child* c = &children[task];
+	c->parent = task / ACTIONS;
+	c->action = task % ACTIONS;
+	State8080* state = w->inst->state;
+	Machine* machine = w->inst->machine;
+	restoreSnapshot(beam[c->parent], state, machine, &w->inst->clock);
+	machine->rports[1] = (machine->rports[1] & ~MOVIE_MASK1) | actions[c->action];
+	machine->rports[2] &= ~MOVIE_MASK2;
+	for (int f = 0; f < frames; f++) runFrame(engine, state, machine, &w->inst->clock);
+	GameState g;
+	readGameState(state, &g);
+	c->score = scoreOf(&g);
+	c->aliensLeft = g.aliensLeft;
+	c->over = !g.playing;
+	c->seen = seenState(explored, stateHash(state, machine));
+	saveSnapshot(c->snap, state, machine, w->inst->clock);
+	w->nodes++;
+}
+
+static void* worker(void* arg) {
+	Worker* w = arg;
+	for (;;) {
+		pthread_barrier_wait(&startLevel);
+		if (atomic_load(&quit)) return NULL;
+		uint32_t task;
+		for (;;) {
+			while (takeTask(w, &task)) expand(w, task);
+			// out of work, take half of somebody else's
+			bool stole = false;
+			int start = w->rng++ % numWorkers;
+			for (int i = 0; i < numWorkers && !stole; i++) {
+				Worker* victim = &workers[(start + i) % numWorkers];
+				if (victim != w) stole = steal(w, victim);
+			}
+			if (!stole) break;
+		}
+		pthread_barrier_wait(&endLevel);
+	}
+}
+
+static uint64_t nextRandom(uint64_t* rng) {
+	*rng ^= *rng << 13;
+	*rng ^= *rng >> 7;
+	*rng ^= *rng << 17;
+	return *rng;
+}
+
+// best first: the score, then fewer aliens left (a hit that hasn't scored yet), then at random
+static int byScore(const void* a, const void* b) {
+	const Child* x = a;
+	const Child* y = b;
+	if (x->score != y->score) return x->score < y->score ? 1 : -1;
+	if (x->aliensLeft != y->aliensLeft) return x->aliensLeft > y->aliensLeft ? 1 : -1;
+	return x->tie > y->tie ? 1 : x->tie < y->tie ? -1 : 0;
+}
+
+// the default start: a coin, 1P start, and on until the game is running
+static Movie* startMovie(State8080* state, Machine* machine, int64_t* clock) {
+	Movie* movie = initMovie();
+	for (int f = 0; f < 600; f++) {
+		u8 p1 = 0;
+		if (f >= 60 && f < 66) p1 = 0x01;
+		if (f >= 120 && f < 126) p1 = 0x04;
+		appendFrame(movie, p1, 0);
+		playFrame(movie, machine, f);
+		runFrame(engine, state, machine, clock);
+		GameState g;
+		readGameState(state, &g);
+		if (f >= 126 && g.playing) break;
+	}
+	return movie;
+}
+
+typedef struct Result {
+	Movie* movie;
+	int64_t score;
+	int steps;
+	int64_t nodes;
+	double secs;
+} Result;
+
+// history[step][i] is which of step - 1's positions beam position i came from and with what
+static Result search(const Movie* start, Snapshot* root, int width, int steps, bool quiet) {
+	int maxChildren = width * ACTIONS;
+	Snapshot** next = malloc(width * sizeof(Snapshot*));
+	beam = malloc(width * sizeof(Snapshot*));
+	children = malloc(maxChildren * sizeof(Child));
+	for (int i = 0; i < width; i++) {
+		beam[i] = copySnapshot(root);
+		next[i] = NULL;
+	}
+	for (int i = 0; i < maxChildren; i++) children[i].snap = copySnapshot(root);
+	int (*history)[2] = malloc((size_t)steps * width * sizeof(int[2]));
+	beamSize = 1;
+	clearTransTable(explored);
+	for (int i = 0; i < numWorkers; i++) workers[i].nodes = 0;
+
+	int64_t best = 0;
+	uint64_t rng = 0x9E3779B97F4A7C15ull;
+	int step = 0;
+	int64_t t0 = currNano();
+	for (; step < steps; step++) {
+		int total = beamSize * ACTIONS;
+		for (int i = 0; i < numWorkers; i++) {
+			uint32_t lo = (uint64_t)total * i / numWorkers, hi = (uint64_t)total * (i + 1) / numWorkers;
+			atomic_store(&workers[i].range, packRange(lo, hi));
+		}
+		pthread_barrier_wait(&startLevel);
+		pthread_barrier_wait(&endLevel);
+
+		for (int i = 0; i < total; i++) children[i].tie = nextRandom(&rng);
+		qsort(children, total, sizeof(Child), byScore);
+		if (children[0].over) break;
+		// every position came out the same as one before, the inputs don't matter yet
+		bool fresh = false;
+		for (int i = 0; i < total && !fresh; i++) fresh = !children[i].seen && !children[i].over;
+		if (!fresh) children[0].seen = false;
+		// the best of the new positions, nothing that's game over
+		int kept = 0;
+		for (int i = 0; i < total && kept < width; i++) {
+			if (children[i].over) break;
+			if (children[i].seen) continue;
+			if (kept == 0) best = children[i].score;
+			history[(size_t)step * width + kept][0] = children[i].parent;
+			history[(size_t)step * width + kept][1] = children[i].action;
+			// swap the snapshot into the beam, the old one gets reused for a child
+			next[kept] = children[i].snap;
+			children[i].snap = NULL;
+			kept++;
+		}
+		for (int i = 0, k = 0; i < total; i++) {
+			if (children[i].snap == NULL) children[i].snap = beam[k++];
+		}
+		for (int i = 0; i < kept; i++) beam[i] = next[i];
+		beamSize = kept;
+		if (!quiet && (step + 1) % 25 == 0) {
+			printf("step %4d: best %lld, %d positions\n", step + 1, (long long)best, beamSize);
+			fflush(stdout);
+		}
+	}
+	Result result;
+	result.secs = (currNano() - t0) / 1e9;
+	result.steps = step;
+	result.score = best;
+	result.nodes = 0;
+	for (int i = 0; i < numWorkers; i++) result.nodes += workers[i].nodes;
+
+	// back from the best of the last step to the root
+	int* line = malloc((step + 1) * sizeof(int));
+	for (int s = step - 1, i = 0; s >= 0; s--) {
+		line[s] = history[(size_t)s * width + i][1];
+		i = history[(size_t)s * width + i][0];
+	}
+	result.movie = initMovie();
+	for (int f = 0; f < start->frames; f++) appendFrame(result.movie, start->inputs[f][0], start->inputs[f][1]);
+	for (int s = 0; s < step; s++) {
+		for (int f = 0; f < frames; f++) appendFrame(result.movie, actions[line[s]], 0);
+	}
+	free(line);
+	free(history);
+
+	// the beam and children between them still hold every snapshot once
+	for (int i = 0; i < maxChildren; i++) free(children[i].snap);
+	for (int i = 0; i < width; i++) free(beam[i]);
+	free(children);
+	free(beam);
+	free(next);
+	return result;
+}
+
+static void startWorkers(int n) {
+	numWorkers = n;
+	workers = aligned_alloc(64, n * sizeof(Worker));
+	pthread_barrier_init(&startLevel, NULL, n + 1);
+	pthread_barrier_init(&endLevel, NULL, n + 1);
+	atomic_store(&quit, false);
+	for (int i = 0; i < n; i++) {
+		Worker* w = &workers[i];
+		memset(w, 0, sizeof(Worker));
+		// one instance each, from a pool of its own
+		w->pool = initPool(1, &boards[0], rom, engine, 0);
+		if (w->pool == NULL) exit(1);
+		w->inst = acquireInstance(w->pool);
+		enableRamHash8080(w->inst->state);
+		w->rng = i * 7 + 1;
+		pthread_create(&w->thread, NULL, worker, w);
+	}
+}
+
+static void stopWorkers() {
+	atomic_store(&quit, true);
+	pthread_barrier_wait(&startLevel);
+	for (int i = 0; i < numWorkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		freePool(workers[i].pool);
+	}
+	pthread_barrier_destroy(&startLevel);
+	pthread_barrier_destroy(&endLevel);
+	free(workers);
+}
+
+int main(int argc, char** argv) {
+	const char* engineName = "aot";
+	const char* movieName = NULL;
+	const char* outName = "best.mov";
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int width = 64;
+	int steps = 200;
+	bool scaling = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-e") && i + 1 < argc) engineName = argv[++i];
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w") && i + 1 < argc) width = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc) steps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc) movieName = argv[++i];
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) outName = argv[++i];
+		else if (!strcmp(argv[i], "-S")) scaling = true;
+		else {
+			printf("usage: %s [-e engine] [-j threads] [-w width] [-n frames] [-d steps] [-m movie] [-o best.mov] [-S]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (threads < 1) threads = 1;
+	if (width < 1 || frames < 1 || steps < 1) {
+		printf("width, frames and steps have to be at least 1\n");
+		return 1;
+	}
+	engine = findEngine(engineName);
+	if (engine == NULL) return 1;
+	rom = loadRom("roms");
+	if (rom == NULL) return 1;
+
+	// where the search starts from
+	State8080* state = initState8080();
+	Machine* machine = initMachine();
+	machineMapMemory(machine, state, rom);
+	if (!attachEngine(engine, state)) return 1;
+	Movie* start;
+	int64_t clock = 0;
+	if (movieName != NULL) {
+		start = loadMovie(movieName);
+		if (start == NULL) return 1;
+		for (int f = 0; f < start->frames; f++) {
+			playFrame(start, machine, f);
+			runFrame(engine, state, machine, &clock);
+		}
+	}
+	else start = startMovie(state, machine, &clock);
+	GameState g;
+	readGameState(state, &g);
+	if (!g.playing) {
+		printf("the game isn't running at the end of the start movie\n");
+		return 1;
+	}
+	Snapshot* root = initSnapshot(state);
+	saveSnapshot(root, state, machine, clock);
+	// room for every position the search could evaluate, at most half full
+	int bits = 16;
+	while (((int64_t)1 << bits) < (int64_t)steps * width * ACTIONS * 2) bits++;
+	explored = initTransTable(bits);
+	if (explored == NULL) return 1;
+
+	if (scaling) {
+		// the same short search on more and more threads
+		int scaleSteps = steps < 20 ? steps : 20;
+		double base = 0;
+		for (int n = 1;; n = n * 2 < threads ? n * 2 : threads) {
+			startWorkers(n);
+			Result r = search(start, root, width, scaleSteps, true);
+			stopWorkers();
+			double rate = r.nodes / r.secs;
+			if (n == 1) base = rate;
+			printf("%3d threads: %8.0f nodes/s, %.2fx\n", n, rate, rate / base);
+			freeMovie(r.movie);
+			if (n == threads) break;
+		}
+		return 0;
+	}
+
+	startWorkers(threads);
+	Result r = search(start, root, width, steps, false);
+	stopWorkers();
+	printf("%d steps of %d frames, best score %lld: %lld nodes in %.2f s on %d threads (%.0f nodes/s, %.0f frames/s)\n",
+		r.steps, frames, (long long)r.score, (long long)r.nodes, r.secs, threads, r.nodes / r.secs, r.nodes * frames / r.secs);
+	if (!saveMovie(r.movie, outName)) return 1;
+	printf("wrote %s (%d frames)\n", outName, r.movie->frames);
+	return 0;
+}
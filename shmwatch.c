@@ -0,0 +1,99 @@
+// watches an emulator publishing its frames to shared memory (platform or headless -P name)
+// from another process, reading each frame in place as it appears
+// prints once a second how many frames it saw and missed, how often it raced the writer, and
+// where the cpu was at the last one
+//
+// usage: ./shmwatch [-n frames] [-p file.ppm] [name]
+//   name  the shared memory object (default /invaders)
+//   -n    stop after seeing this many frames
+//   -p    also save the last frame seen as a PPM on the way out
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "publish.h"
+#include "capture.h"
+#include "hash.h"
+#include "platform.h"
+
+int main(int argc, char** argv) {
+	const char* name = "/invaders";
+	const char* ppmName = NULL;
+	int limit = -1;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) limit = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc) ppmName = argv[++i];
+		else if (argv[i][0] != '-') name = argv[i];
+		else {
+			printf("usage: %s [-n frames] [-p file.ppm] [name]\n", argv[0]);
+			return 1;
+		}
+	}
+	const PublishRing* ring = openPublished(name);
+	if (ring == NULL) return 1;
+
+	static PublishedFrame last;
+	uint32_t next = atomic_load_explicit((_Atomic uint32_t*)&ring->latest, memory_order_acquire);
+	int seen = 0, missed = 0, torn = 0, total = 0;
+	uint64_t hash = 0;
+	int64_t report = currNano() + 1000000000;
+	int64_t idleSince = currNano();
+	while (limit < 0 || total < limit) {
+		uint32_t latest = atomic_load_explicit((_Atomic uint32_t*)&ring->latest, memory_order_acquire);
+		if (latest < next) next = latest; // the emulator started over
+		if (latest == next) {
+			// nothing new for a few seconds, it's probably gone
+			if (currNano() - idleSince > 5000000000ll) break;
+			usleep(1000);
+			continue;
+		}
+		idleSince = currNano();
+		// the ones already written over again are gone
+		if (latest - next > PUBLISH_SLOTS) {
+			missed += latest - next - PUBLISH_SLOTS;
+			next = latest - PUBLISH_SLOTS;
+		}
+		for (; next < latest; next++) {
+			for (;;) {
+				uint32_t seq;
+				const PublishedFrame* slot = beginRead(ring, next, &seq);
+				if (slot == NULL) {
+					if (seq & 1) continue;
+					missed++;
+					break;
+				}
+				// hashed where it lies, only copied if it's the one to keep
+				uint64_t h = xxh64(slot->vram, VRAM_SZ, 0);
+				if (ppmName != NULL) memcpy(&last, slot, sizeof(PublishedFrame));
+				else {
+					last.frame = slot->frame;
+					last.cycles = slot->cycles;
+					last.pc = slot->pc;
+					last.sp = slot->sp;
+					memcpy(last.ports, slot->ports, 3);
+				}
+				if (!endRead(slot, seq)) {
+					torn++;
+					continue;
+				}
+				hash = h;
+				seen++;
+				total++;
+				break;
+			}
+		}
+		if (currNano() >= report) {
+			printf("%4d frames seen %3d missed %3d retried, frame %u cycle %lld pc %04X sp %04X ports %02X %02X vram %016llx\n",
+				seen, missed, torn, last.frame, (long long)last.cycles, last.pc, last.sp, last.ports[1], last.ports[2], (unsigned long long)hash);
+			fflush(stdout);
+			seen = missed = torn = 0;
+			report += 1000000000;
+		}
+	}
+	printf("%d frames, last %u vram %016llx\n", total, last.frame, (unsigned long long)hash);
+	if (ppmName != NULL && total > 0 && !saveVramPpm(ppmName, last.vram, 2)) return 1;
+	closePublished(ring);
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+// RAM that lives at its own address in state->memory, mirrors point somewhere else
+static bool ownPage(const State8080* state, int p) {
+	return !(state->pageFlags[p] & PAGE_ROM) && state->wbase[p] == state->memory + (p << PAGE_SHIFT);
+}
+
+static size_t snapshotSize(int ramPages) {
+	return sizeof(Snapshot) + (size_t)ramPages * PAGE_SZ;
+}
+
+Snapshot* initSnapshot(const State8080* state) {
+	int pages = 0;
+	for (int p = 0; p < NUM_PAGES; p++) pages += ownPage(state, p);
+	Snapshot* snap = calloc(1, snapshotSize(pages));
+	snap->ramPages = pages;
+	return snap;
+}
+
+void saveSnapshot(Snapshot* snap, const State8080* state, const Machine* mach, int64_t clock) {
+	memcpy(snap->regs, state->regs, 8);
+	snap->psw = state->psw;
+	snap->pc = state->pc;
+	snap->sp = state->sp;
+	for (int i = 0; i < 3; i++) snap->interruptbus[i] = state->interruptbus[i];
+	snap->interruptPending = state->interruptPending;
+	snap->interrupted = state->interrupted;
+	snap->eiDelay = state->eiDelay;
+	snap->halted = state->halted;
+	snap->interruptsEnabled = state->interruptsEnabled;
+	snap->idleArmed = state->idleArmed;
+	snap->idleHead = state->idleHead;
+	snap->idleFrom = state->idleFrom;
+	memcpy(snap->idleRegs, state->idleRegs, 8);
+	snap->idlePsw = state->idlePsw;
+	snap->idleSp = state->idleSp;
+	snap->idleCycles = state->idleCycles;
+	snap->machine = *mach;
+	snap->clock = clock;
+	snap->ramHashed = state->ramHashed;
+	snap->ramHash = state->ramHash;
+	u8* ram = snap->ram;
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (!ownPage(state, p)) continue;
+		memcpy(ram, state->memory + (p << PAGE_SHIFT), PAGE_SZ);
+		ram += PAGE_SZ;
+	}
+}
+
+void restoreSnapshot(const Snapshot* snap, State8080* state, Machine* mach, int64_t* clock) {
+	memcpy(state->regs, snap->regs, 8);
+	state->psw = snap->psw;
+	state->pc = snap->pc;
+	state->sp = snap->sp;
+	for (int i = 0; i < 3; i++) state->interruptbus[i] = snap->interruptbus[i];
+	state->interruptPending = snap->interruptPending;
+	state->interrupted = snap->interrupted;
+	state->eiDelay = snap->eiDelay;
+	state->halted = snap->halted;
+	state->interruptsEnabled = snap->interruptsEnabled;
+	state->idleArmed = snap->idleArmed;
+	state->idleHead = snap->idleHead;
+	state->idleFrom = snap->idleFrom;
+	memcpy(state->idleRegs, snap->idleRegs, 8);
+	state->idlePsw = snap->idlePsw;
+	state->idleSp = snap->idleSp;
+	state->idleCycles = snap->idleCycles;
+	*mach = snap->machine;
+	*clock = snap->clock;
+	const u8* ram = snap->ram;
+	for (int p = 0; p < NUM_PAGES; p++) {
+		if (!ownPage(state, p)) continue;
+		memcpy(state->memory + (p << PAGE_SHIFT), ram, PAGE_SZ);
+		ram += PAGE_SZ;
+	}
+	if (state->ramHashed) state->ramHash = snap->ramHashed ? snap->ramHash : computeRamHash8080(state);
+}
+
+Snapshot* copySnapshot(const Snapshot* snap) {
+	Snapshot* copy = malloc(snapshotSize(snap->ramPages));
+	memcpy(copy, snap, snapshotSize(snap->ramPages));
+	return copy;
+}
@@ -0,0 +1,46 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// everything a running game would lose on a reboot: the cpu, the machine, the clock and the
+// contents of RAM, restored into the same (already mapped) state rather than building a new one
+// only the pages a state writes to its own memory are kept (mirrors come back with them, ROM
+// never changed), which for Space Invaders is the 8 KB at [0x2000, 0x4000)
+typedef struct Snapshot {
+	u8 regs[8];
+	u8 psw;
+	u16 pc;
+	u16 sp;
+	u8 interruptbus[3];
+	bool interruptPending;
+	bool interrupted;
+	bool eiDelay;
+	bool halted;
+	bool interruptsEnabled;
+	bool idleArmed;
+	u16 idleHead;
+	u16 idleFrom;
+	u8 idleRegs[8];
+	u8 idlePsw;
+	u16 idleSp;
+	u16 idleCycles;
+	Machine machine;
+	int64_t clock;
+	bool ramHashed; // whether ramHash is the state's, else restoring into a hashed state rehashes
+	uint64_t ramHash;
+	int ramPages;
+	u8 ram[]; // the RAM pages in address order
+} Snapshot;
+
+// sized for state's memory map, only restore it into states mapped the same way
+Snapshot* initSnapshot(const State8080* state);
+void saveSnapshot(Snapshot* snap, const State8080* state, const Machine* mach, int64_t clock);
+void restoreSnapshot(const Snapshot* snap, State8080* state, Machine* mach, int64_t* clock);
+// a new snapshot holding the same
+Snapshot* copySnapshot(const Snapshot* snap);
+
+#endif
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "telemetry.h"
+#include "platform.h"
+
+static const char* metricNames[TM_METRICS] = {"cycles", "cpu_ns", "convert_ns", "present_ns", "jitter_ns"};
+
+static int bucketFor(uint64_t value) {
+	if (value < (1 << TELEMETRY_SUB_BITS)) return value;
+	int e = 63 - __builtin_clzll(value);
+	return ((e - TELEMETRY_SUB_BITS + 1) << TELEMETRY_SUB_BITS) + ((value >> (e - TELEMETRY_SUB_BITS)) & ((1 << TELEMETRY_SUB_BITS) - 1));
+}
+
+// the middle of the bucket
+static uint64_t bucketValue(int bucket) {
+	if (bucket < (1 << TELEMETRY_SUB_BITS)) return bucket;
+	int e = (bucket >> TELEMETRY_SUB_BITS) + TELEMETRY_SUB_BITS - 1;
+	uint64_t sub = bucket & ((1 << TELEMETRY_SUB_BITS) - 1);
+	uint64_t low = ((1 << TELEMETRY_SUB_BITS) + sub) << (e - TELEMETRY_SUB_BITS);
+	return low + ((uint64_t)1 << (e - TELEMETRY_SUB_BITS)) / 2;
+}
+
+void telemetryRecord(TelemetryThread* t, enum TelemetryMetric metric, int64_t value) {
+	if (value < 0) value = -value;
+	t->current.values[metric] = value;
+	// only this thread writes, so no read-modify-write needed
+	_Atomic uint64_t* count = &t->counts[metric][bucketFor(value)];
+	atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+	_Atomic uint64_t* sum = &t->sums[metric];
+	atomic_store_explicit(sum, atomic_load_explicit(sum, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void telemetryEndFrame(TelemetryThread* t) {
+	t->recent[t->frames % TELEMETRY_RECENT] = t->current;
+	memset(&t->current, 0, sizeof(FrameTiming));
+	t->frames++;
+}
+
+const FrameTiming* telemetryRecent(const TelemetryThread* t, int ago) {
+	return &t->recent[(t->frames - 1 - ago) % TELEMETRY_RECENT];
+}
+
+typedef struct Summary {
+	uint64_t count, mean, p50, p90, p99, max;
+} Summary;
+
+// what was recorded since the last dump
+static Summary summarize(TelemetryThread* t, enum TelemetryMetric metric) {
+	uint64_t counts[TELEMETRY_BUCKETS];
+	Summary s = {0};
+	for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+		uint64_t now = atomic_load_explicit(&t->counts[metric][b], memory_order_relaxed);
+		counts[b] = now - t->lastCounts[metric][b];
+		t->lastCounts[metric][b] = now;
+		s.count += counts[b];
+	}
+	uint64_t sum = atomic_load_explicit(&t->sums[metric], memory_order_relaxed);
+	// the sum may be a sample ahead of the counts, close enough for a mean
+	if (s.count > 0) s.mean = (sum - t->lastSums[metric]) / s.count;
+	t->lastSums[metric] = sum;
+	uint64_t seen = 0;
+	for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+		if (counts[b] == 0) continue;
+		seen += counts[b];
+		uint64_t v = bucketValue(b);
+		if (s.p50 == 0 && seen * 100 >= s.count * 50) s.p50 = v;
+		if (s.p90 == 0 && seen * 100 >= s.count * 90) s.p90 = v;
+		if (s.p99 == 0 && seen * 100 >= s.count * 99) s.p99 = v;
+		s.max = v;
+	}
+	return s;
+}
+
+static void dump(Telemetry* tel) {
+	int64_t ms = (currNano() - tel->start) / 1000000;
+	int n = atomic_load_explicit(&tel->numThreads, memory_order_acquire);
+	for (int i = 0; i < n; i++) {
+		TelemetryThread* t = tel->threads[i];
+		if (!tel->csv) fprintf(tel->out, "{\"t_ms\":%lld,\"thread\":\"%s\"", (long long)ms, t->name);
+		for (int m = 0; m < TM_METRICS; m++) {
+			Summary s = summarize(t, m);
+			if (s.count == 0) continue;
+			if (tel->csv) {
+				fprintf(tel->out, "%lld,%s,%s,%llu,%llu,%llu,%llu,%llu,%llu\n", (long long)ms, t->name, metricNames[m],
+					(unsigned long long)s.count, (unsigned long long)s.mean, (unsigned long long)s.p50,
+					(unsigned long long)s.p90, (unsigned long long)s.p99, (unsigned long long)s.max);
+			}
+			else {
+				fprintf(tel->out, ",\"%s\":{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}", metricNames[m],
+					(unsigned long long)s.count, (unsigned long long)s.mean, (unsigned long long)s.p50,
+					(unsigned long long)s.p90, (unsigned long long)s.p99, (unsigned long long)s.max);
+			}
+		}
+		if (!tel->csv) fprintf(tel->out, "}\n");
+	}
+	fflush(tel->out);
+}
+
+static void* dumpThread(void* arg) {
+	Telemetry* tel = arg;
+	// wake up often enough to notice done, dump on the period
+	struct timespec nap = {0, 10000000};
+	int64_t next = tel->start + tel->periodMs * 1000000L;
+	while (!atomic_load(&tel->done)) {
+		nanosleep(&nap, NULL);
+		if (currNano() < next) continue;
+		dump(tel);
+		next += tel->periodMs * 1000000L;
+	}
+	dump(tel);
+	return NULL;
+}
+
+Telemetry* initTelemetry(const char* path, int periodMs) {
+	Telemetry* tel = malloc(sizeof(Telemetry));
+	tel->path = path;
+	tel->out = NULL;
+	tel->periodMs = periodMs < 1 ? 1 : periodMs;
+	atomic_init(&tel->numThreads, 0);
+	atomic_init(&tel->done, false);
+	tel->start = currNano();
+	if (path == NULL) return tel;
+	const char* dot = strrchr(path, '.');
+	tel->csv = dot != NULL && !strcmp(dot, ".csv");
+	tel->out = fopen(path, "w");
+	if (tel->out == NULL) {
+		printf("Could not write %s\n", path);
+		free(tel);
+		return NULL;
+	}
+	if (tel->csv) fprintf(tel->out, "t_ms,thread,metric,count,mean,p50,p90,p99,max\n");
+	pthread_create(&tel->thread, NULL, dumpThread, tel);
+	return tel;
+}
+
+TelemetryThread* telemetryThread(Telemetry* tel, const char* name) {
+	int n = atomic_load(&tel->numThreads);
+	if (n == TELEMETRY_THREADS) return NULL;
+	TelemetryThread* t = calloc(1, sizeof(TelemetryThread));
+	t->name = name;
+	tel->threads[n] = t;
+	// publishes the zeroed histograms along with the count
+	atomic_store_explicit(&tel->numThreads, n + 1, memory_order_release);
+	return t;
+}
+
+void freeTelemetry(Telemetry* tel) {
+	if (tel->out != NULL) {
+		atomic_store(&tel->done, true);
+		pthread_join(tel->thread, NULL);
+		fclose(tel->out);
+		printf("telemetry written to %s\n", tel->path);
+	}
+	for (int i = 0; i < tel->numThreads; i++) free(tel->threads[i]);
+	free(tel);
+}
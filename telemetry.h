@@ -0,0 +1,72 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// what gets measured each frame, times are host nanoseconds (currNano)
+enum TelemetryMetric {
+	TM_CYCLES, // emulated cycles executed (skipped idle/halt cycles included)
+	TM_CPU, // in the core (runCpu)
+	TM_CONVERT, // turning VRAM into window pixels
+	TM_PRESENT, // SDL_UpdateWindowSurface
+	TM_JITTER, // how far the time since the last vblank was from 1/60 s, either way
+	TM_METRICS
+};
+
+// log-linear buckets: exact below 8, then 8 per power of two (within 12.5%)
+#define TELEMETRY_SUB_BITS 3
+#define TELEMETRY_BUCKETS ((64 - TELEMETRY_SUB_BITS + 1) << TELEMETRY_SUB_BITS)
+// the frames kept for the overlay
+#define TELEMETRY_RECENT 128
+#define TELEMETRY_THREADS 8
+
+typedef struct FrameTiming {
+	int64_t values[TM_METRICS];
+} FrameTiming;
+
+// one per recording thread, only that thread writes it so recording is a relaxed load and store,
+// the dump thread reads the counts whenever it likes
+typedef struct TelemetryThread {
+	const char* name;
+	_Atomic uint64_t counts[TM_METRICS][TELEMETRY_BUCKETS];
+	_Atomic uint64_t sums[TM_METRICS];
+	// the owning thread's own view, for the overlay
+	FrameTiming current;
+	FrameTiming recent[TELEMETRY_RECENT];
+	uint32_t frames;
+	// the dump thread's copy of the counts at the last dump, so each dump covers one period
+	uint64_t lastCounts[TM_METRICS][TELEMETRY_BUCKETS];
+	uint64_t lastSums[TM_METRICS];
+} TelemetryThread;
+
+typedef struct Telemetry {
+	const char* path;
+	FILE* out; // NULL when only the overlay wants the numbers
+	bool csv;
+	int periodMs;
+	TelemetryThread* threads[TELEMETRY_THREADS];
+	_Atomic int numThreads;
+	atomic_bool done;
+	int64_t start;
+	pthread_t thread;
+} Telemetry;
+
+// dumps every periodMs to path (CSV if it ends in .csv, else a JSON object per line) from a
+// background thread, path NULL just collects, NULL (after printing why) if path can't be opened
+Telemetry* initTelemetry(const char* path, int periodMs);
+// a histogram set for the calling thread to record into, NULL if there are already TELEMETRY_THREADS
+// (threads register one at a time, before they start recording)
+TelemetryThread* telemetryThread(Telemetry* tel, const char* name);
+void telemetryRecord(TelemetryThread* t, enum TelemetryMetric metric, int64_t value);
+// closes the frame being recorded into t->recent
+void telemetryEndFrame(TelemetryThread* t);
+// the frame ago frames back (0 is the last finished one)
+const FrameTiming* telemetryRecent(const TelemetryThread* t, int ago);
+// writes a last dump, stops the thread and closes the file
+void freeTelemetry(Telemetry* tel);
+
+#endif
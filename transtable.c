@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transtable.h"
+
+TransTable* initTransTable(int bits) {
+	TransTable* table = malloc(sizeof(TransTable));
+	size_t slots = (size_t)1 << bits;
+	table->mask = slots - 1;
+	table->slots = calloc(slots, sizeof(uint64_t));
+	if (table->slots == NULL) {
+		printf("Could not allocate a transposition table of %zu slots\n", slots);
+		free(table);
+		return NULL;
+	}
+	atomic_init(&table->count, 0);
+	return table;
+}
+
+void freeTransTable(TransTable* table) {
+	free(table->slots);
+	free(table);
+}
+
+void clearTransTable(TransTable* table) {
+	memset(table->slots, 0, (table->mask + 1) * sizeof(uint64_t));
+	atomic_store(&table->count, 0);
+}
+
+bool seenState(TransTable* table, uint64_t hash) {
+	uint64_t key = hash ? hash : 1;
+	for (uint64_t i = 0; i < TRANS_PROBES; i++) {
+		_Atomic uint64_t* slot = &table->slots[(key + i) & table->mask];
+		uint64_t found = atomic_load_explicit(slot, memory_order_relaxed);
+		if (found == 0) {
+			if (atomic_compare_exchange_strong_explicit(slot, &found, key, memory_order_relaxed, memory_order_relaxed)) {
+				atomic_fetch_add_explicit(&table->count, 1, memory_order_relaxed);
+				return false;
+			}
+			// somebody took it first, found is now what they put there
+		}
+		if (found == key) return true;
+	}
+	return false;
+}
+
+bool lookupState(TransTable* table, uint64_t hash) {
+	uint64_t key = hash ? hash : 1;
+	for (uint64_t i = 0; i < TRANS_PROBES; i++) {
+		uint64_t found = atomic_load_explicit(&table->slots[(key + i) & table->mask], memory_order_relaxed);
+		if (found == key) return true;
+		if (found == 0) return false;
+	}
+	return false;
+}
+
+static uint64_t mix(uint64_t h, uint64_t word) {
+	h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+	return h ^ h >> 31;
+}
+
+uint64_t stateHash(const State8080* state, const Machine* mach) {
+	uint64_t h = state->ramHashed ? state->ramHash : computeRamHash8080(state);
+	uint64_t regs;
+	memcpy(&regs, state->regs, 8);
+	regs &= ~((uint64_t)0xFF << (REG_M * 8)); // M isn't a register
+	h = mix(h, regs);
+	h = mix(h, (uint64_t)state->psw | (uint64_t)state->pc << 8 | (uint64_t)state->sp << 24 |
+		(uint64_t)state->interruptsEnabled << 40 | (uint64_t)state->interruptPending << 41 |
+		(uint64_t)state->eiDelay << 42 | (uint64_t)state->halted << 43);
+	h = mix(h, (uint64_t)state->interruptbus[0] | (uint64_t)state->interruptbus[1] << 8 | (uint64_t)state->interruptbus[2] << 16);
+	uint64_t ports;
+	memcpy(&ports, mach->rports, 8);
+	h = mix(h, ports);
+	h = mix(h, (uint64_t)mach->wport2 | (uint64_t)mach->wport4 << 8);
+	return h;
+}
@@ -0,0 +1,40 @@
+#ifndef TRANSTABLE_H
+#define TRANSTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "emulate8080.h"
+#include "machine.h"
+
+// a set of machine states, by hash, that any number of threads add to at once without locking,
+// for batch drivers (search, fuzzing) to skip states something has already explored
+// open addressed with linear probing, a slot only ever goes from empty to its key (one CAS) so
+// finding an empty slot means the key isn't further on
+// when a probe runs out the state counts as new and isn't kept: a full table costs some
+// exploring twice, never skipping something nobody explored
+#define TRANS_PROBES 32
+
+typedef struct TransTable {
+	uint64_t mask; // slots - 1
+	_Atomic int64_t count;
+	_Atomic uint64_t* slots; // key + 0 is empty, a hash of 0 is kept as 1
+} TransTable;
+
+// 1 << bits slots, NULL (after printing why) if they can't be had
+TransTable* initTransTable(int bits);
+void freeTransTable(TransTable* table);
+// not while anything else is using it
+void clearTransTable(TransTable* table);
+// true if hash was already there, else adds it
+bool seenState(TransTable* table, uint64_t hash);
+bool lookupState(TransTable* table, uint64_t hash);
+
+// the hash of everything that decides what the machine does next: RAM, the cpu and the ports
+// RAM's share is state->ramHash when it's kept up to date (enableRamHash8080), which makes this
+// O(1), else it's hashed from scratch
+// the clock isn't in it, states at different points of a frame hash the same
+uint64_t stateHash(const State8080* state, const Machine* mach);
+
+#endif